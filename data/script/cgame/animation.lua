@@ -1,121 +1,108 @@
-cs.animation = { auto_saveload = true }
+local ffi = require 'ffi'
 
-cs.animation.tbl = cg.entity_table()
+-- thin wrapper around the C animation system, see animation.h
 
-function cs.animation.add(ent)
-    if cs.animation.tbl[ent] then return end
+-- names come back from C as const char *, NULL if none
+local function tostr(s)
+    if s == nil then return nil end
+    return ffi.string(s)
+end
+
+cs.animation = {}
 
-    cs.animation.tbl[ent] = {
-        ent = ent,
-        anims = {},
-        curr_anim = nil,   -- name of animation
-        frame = 1,         -- index of frame
-        t = 1,             -- time left in this frame
-    }
+function cs.animation.add(ent)
+    cg.animation_add(ent)
 end
 function cs.animation.remove(ent, anim)
-    local entry = cs.animation.tbl[ent]
-    if entry then
-        if anim then
-            if entry.curr_anim == anim then
-                entry.curr_anim = nil
-            end
-            entry.anims[anim] = nil
-        else
-            cs.animation.tbl[ent] = nil
-        end
+    if anim then
+        if cg.animation_has(ent) then cg.animation_remove_anim(ent, anim) end
+    else
+        cg.animation_remove(ent)
     end
 end
 function cs.animation.has(ent)
-    return cs.animation.tbl[ent] ~= nil
+    return cg.animation_has(ent)
 end
 
--- utility for contiguous strips of frames
+-- utility for contiguous strips of frames, tbl maps animation names to
+-- { n = ..., t = ..., base = ..., after = ... }
 function cs.animation.set_strips(ent, tbl)
-    local entry = cs.animation.tbl[ent]
-    assert(entry, 'entity must be in animation system')
     for anim, strip in pairs(tbl) do
-        entry.anims[anim] = { n = strip.n, strip = strip }
+        cg.animation_set_strip(ent, anim, strip.n or 1, strip.t or 1,
+                               strip.base or cg.vec2_zero)
+        if strip.after then cg.animation_set_after(ent, anim, strip.after) end
     end
 end
 
--- manual specification of every frame and its duration
+-- manual specification of every frame and its duration, tbl maps animation
+-- names to arrays of { t = ..., texcell = ..., texsize = ... } where
+-- texcell and texsize are optional
 function cs.animation.set_frames(ent, tbl)
-    local entry = cs.animation.tbl[ent]
-    assert(entry, 'entity must be in animation system')
-    for anim, frames in pairs(anim) do
-        entry.anims[anim] = { n = #frames, frames = frames }
+    for anim, frames in pairs(tbl) do
+        local arr = ffi.new('AnimationFrame[?]', #frames)
+        for i, frm in ipairs(frames) do
+            local f = arr[i - 1]
+            f.t = frm.t or 1
+            if frm.texcell then
+                f.texcell = frm.texcell
+                f.set_texcell = true
+            end
+            if frm.texsize then
+                f.texsize = frm.texsize
+                f.set_texsize = true
+            end
+        end
+        cg.animation_set_frames(ent, anim, #frames, arr)
     end
 end
 
-local function _enter_frame(entry, frame, anim)
-    anim = anim or entry.anims[entry.curr_anim]
-    entry.frame = frame
-    if anim.strip then
-        entry.t = anim.strip.t > 0 and anim.strip.t or 1
-        local v = cg.Vec2(anim.strip.base)
-        v.x = v.x + (frame - 1) * cs.sprite.get_texsize(entry.ent).x
-        cs.sprite.set_texcell(entry.ent, v)
-    elseif anim.frames then
-        local frm = anim.frames[frame]
-        entry.t = frm.t > 0 and frm.t or 1
-        if frm.texcell then cs.sprite.set_texcell(entry.ent, frm.texcell) end
-        if frm.texsize then cs.sprite.set_texsize(entry.ent, frm.texsize) end
+function cs.animation.set_after(ent, anim, after)
+    cg.animation_set_after(ent, anim, after)
+end
+function cs.animation.get_after(ent, anim)
+    return tostr(cg.animation_get_after(ent, anim))
+end
+
+-- set of names of all animations of ent
+function cs.animation.get_anims(ent)
+    local anims = {}
+    for i = 0, cg.animation_get_num_anims(ent) - 1 do
+        anims[ffi.string(cg.animation_get_nth_anim(ent, i))] = true
     end
+    return anims
 end
 
-function cs.animation.get_curr_anim(ent, anim)
-    local entry = cs.animation.tbl[ent]
-    assert(entry, 'entity must be in animation system')
-    return entry.curr_anim
+function cs.animation.get_curr_anim(ent)
+    return tostr(cg.animation_get_curr_anim(ent))
 end
 
 function cs.animation.switch(ent, anim)
-    local entry = cs.animation.tbl[ent]
-    assert(entry, 'entity must be in animation system')
-    assert(entry.anims[anim], "must have an animation with name '"
-               .. anim .. "'")
-    if entry.curr_anim ~= anim then
-        entry.curr_anim = anim
-        _enter_frame(entry, 1)
-    end
+    cg.animation_switch(ent, anim)
 end
 
 function cs.animation.start(ent, anim)
-    local entry = cs.animation.tbl[ent]
-    assert(entry, 'entity must be in animation system')
-    assert(entry.anims[anim], "must have an animation with name '"
-               .. anim .. "'")
-    entry.curr_anim = anim
-    _enter_frame(entry, 1)
+    cg.animation_start(ent, anim)
 end
 
-function cs.animation.update_all()
-    cg.entity_table_remove_destroyed(cs.animation.tbl, cs.animation.remove)
-
-    if cs.timing.get_paused() then return end
+-- C saves/loads its own data, this picks up data saved by the older Lua
+-- version of this system
+function cs.animation.load_all(dump)
+    if not dump.tbl then return end
 
-    for ent, entry in pairs(cs.animation.tbl) do
-        if entry.curr_anim then
-            local dt = cs.timing.dt
-            local anim = entry.anims[entry.curr_anim]
-
-            -- next frame?
-            while entry.t <= dt do
-                if anim.after and entry.frame >= anim.n then
-                    assert(entry.anims[anim.after], "must have an animation "
-                               .. "with name '" .. anim.after .. "'")
-                    entry.curr_anim = anim.after
-                    entry.frame = 1
-                    anim = entry.anims[anim.after]
-                end
-                _enter_frame(entry, entry.frame >= anim.n
-                                 and 1 or entry.frame + 1, anim)
-                dt = dt - entry.t
+    for ent, entry in pairs(dump.tbl) do
+        cs.animation.add(ent)
+        for name, anim in pairs(entry.anims) do
+            if anim.strip then
+                cg.animation_set_strip(ent, name, anim.n, anim.strip.t,
+                                       anim.strip.base)
+            elseif anim.frames then
+                cs.animation.set_frames(ent, { [name] = anim.frames })
             end
-
-            entry.t = entry.t - dt
         end
+        for name, anim in pairs(entry.anims) do
+            if anim.after then cs.animation.set_after(ent, name, anim.after) end
+        end
+        if entry.curr_anim then cs.animation.start(ent, entry.curr_anim) end
     end
 end
 
@@ -156,12 +143,11 @@ cs.edit_inspector.custom['animation'] = {
 
     post_update = function (inspector)
         local ent = inspector.ent
-        local entry = cs.animation.tbl[ent]
-        local anims = entry.anims
+        local anims = cs.animation.get_anims(ent)
 
         -- current animation
         cg.edit_field_post_update(
-            inspector.curr_anim, entry.curr_anim or '(none)',
+            inspector.curr_anim, cs.animation.get_curr_anim(ent) or '(none)',
             function (v) cs.animation.switch(ent, v) end,
             anims)
 
@@ -175,7 +161,7 @@ cs.edit_inspector.custom['animation'] = {
         end
 
         -- add missing views
-        for name, anim in pairs(anims) do
+        for name in pairs(anims) do
             if not inspector.anim_views[name] then
                 local view = {}
                 inspector.anim_views[name] = view
@@ -238,18 +224,17 @@ cs.edit_inspector.custom['animation'] = {
         for name, view in pairs(inspector.anim_views) do
             if cs.entity.destroyed(view.window) then
                 cs.animation.remove(ent, name)
-            else
-                local anim = anims[name]
+            elseif cg.animation_get_is_strip(ent, name) then
+                local n = cg.animation_get_num_frames(ent, name)
+                local t = cg.animation_get_strip_t(ent, name)
+                local base = cg.Vec2(cg.animation_get_strip_base(ent, name))
+                local after = cs.animation.get_after(ent, name)
 
                 -- duplicate?
                 if cs.gui.event_mouse_down(view.dup_text) == cg.MC_LEFT then
                     local function new_strip(s)
                         local strips = {
-                            [s] = {
-                                n = anim.n, t = anim.strip.t,
-                                base = cg.Vec2(anim.strip.base),
-                                after = anim.after
-                            }
+                            [s] = { n = n, t = t, base = base, after = after }
                         }
                         cs.animation.set_strips(ent, strips)
                     end
@@ -258,20 +243,24 @@ cs.edit_inspector.custom['animation'] = {
 
                 -- update fields
                 cg.edit_field_post_update(
-                    view.n, anim.n,
-                    function (v) anim.n = v end)
+                    view.n, n,
+                    function (v)
+                        cg.animation_set_strip(ent, name, v, t, base)
+                    end)
                 cg.edit_field_post_update(
-                    view.t, anim.strip.t,
+                    view.t, t,
                     function (v)
-                        anim.strip.t = v
-                        entry.t = v > 0 and v or 1
+                        cg.animation_set_strip(ent, name, n, v, base)
                     end)
                 cg.edit_field_post_update(
-                    view.base, anim.strip.base,
-                    function (v) anim.strip.base = v end)
+                    view.base, base,
+                    function (v)
+                        cg.animation_set_strip(ent, name, n, t, v)
+                    end)
                 cg.edit_field_post_update(
-                    view.after, anim.after or '(none)',
-                    function (s) anim.after = s end, anims)
+                    view.after, after or '(none)',
+                    function (s) cs.animation.set_after(ent, name, s) end,
+                    anims)
             end
         end
     end,
@@ -660,6 +660,8 @@ cs.meta.props['sprite'] = {
     { name = 'texcell' },
     { name = 'texsize' },
     { name = 'depth' },
+    { name = 'entity_atlas' },
+    { name = 'static' },
 }
 
 cs.meta.props['physics'] = {
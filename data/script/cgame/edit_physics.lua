@@ -227,7 +227,7 @@ end
 function cs.edit.phypoly_add_vertex()
     local m = cs.camera.unit_to_world(cs.input.get_mouse_pos_unit())
     -- TODO: remove scaling issue
-    local t = cg.mat3_inverse(cs.transform.get_world_matrix(phypoly_ent))
+    local t = cs.transform.get_inverse_world_matrix(phypoly_ent)
     table.insert(phypoly_verts, cg.Vec2(cg.mat3_transform(t, m)))
     phypoly_update_verts()
 end
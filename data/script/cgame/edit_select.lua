@@ -31,8 +31,8 @@ local function _get_entities_under_mouse()
         local pair = cs.edit.bboxes_get_nth(i)
 
         -- transform m to local space
-        local t = cg.mat3_inverse(cs.transform.get_world_matrix(pair.ent))
-        if cg.bbox_contains(pair.bbox, cg.mat3_transform(t, m)) then
+        local p = cs.transform.world_to_local(pair.ent, m)
+        if cg.bbox_contains(pair.bbox, p) then
             table.insert(ents, cg.Entity(pair.ent))
         end
     end
@@ -78,7 +78,7 @@ function cs.edit.modes.grab.update_all()
         if anc == cg.entity_nil then
             -- find translation in parent space
             local parent = cs.transform.get_parent(ent)
-            local m = cg.mat3_inverse(cs.transform.get_world_matrix(parent))
+            local m = cs.transform.get_inverse_world_matrix(parent)
             local d = cg.mat3_transform(m, mc)
                 - cg.mat3_transform(m, ms)
             d = d + cg.mat3_transform(m, grab_disp)
@@ -1,6 +1,30 @@
+local ffi = require 'ffi'
+
 local old_entity_create = cg.entity_create
 function cg.entity_create()
     local e = old_entity_create()
     cs.group.add(e, 'default')
     return e
 end
+
+-- returns a new Entity[n] array (0-indexed)
+local old_entity_create_n = cg.entity_create_n
+function cg.entity_create_n(n)
+    local ents = ffi.new('Entity[?]', n)
+    old_entity_create_n(n, ents)
+    for i = 0, n - 1 do
+        cs.group.add(ents[i], 'default')
+    end
+    return ents
+end
+
+-- iterate over entities in all of given EntityPools, eg.
+--   for e in cg.entitypool_join(cs.transform.get_pool(), cs.sprite.get_pool())
+function cg.entitypool_join(...)
+    local n = select('#', ...)
+    local join = ffi.new('EntityPoolJoin')
+    cg.entitypool_join_begin(join, ffi.new('EntityPool *[?]', n, ...), n)
+    return function ()
+        if cg.entitypool_join_next(join) then return join.ent end
+    end
+end
@@ -1,6 +1,7 @@
 local ffi = require 'ffi'
 
 cg.Collision = ffi.metatype('Collision', {})
+cg.CollisionEvent = ffi.metatype('CollisionEvent', {})
 
 local old_physics_shape_add_box = cg.physics_shape_add_box
 function cg.physics_shape_add_box(ent, b, r)
@@ -38,3 +39,12 @@ function cg.physics_get_collisions(ent)
     end
     return lua_arr
 end
+
+-- returns the C buffer itself and its length, index it 0 to n - 1 --
+-- removing bodies may move the buffer, so get it again after doing that
+-- and don't hold on to it past the current frame
+local old_physics_get_collision_events = cg.physics_get_collision_events
+function cg.physics_get_collision_events()
+    return old_physics_get_collision_events(),
+        cg.physics_get_num_collision_events()
+end
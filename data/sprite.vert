@@ -1,8 +1,8 @@
 #version 150
 
-in vec3 wmat1; // columns 1, 2, 3 of transform matrix
-in vec3 wmat2;
-in vec3 wmat3;
+in vec2 wmat1; // columns 1, 2, 3 of transform matrix, last row left out
+in vec2 wmat2;
+in vec2 wmat3;
 in vec2 size;
 in vec2 texcell;
 in vec2 texsize;
@@ -14,7 +14,7 @@ out vec2 texsize_;
 
 void main()
 {
-    wmat = mat3(wmat1, wmat2, wmat3);
+    wmat = mat3(vec3(wmat1, 0.0), vec3(wmat2, 0.0), vec3(wmat3, 1.0));
     size_ = size;
     texcell_ = texcell;
     texsize_ = texsize;
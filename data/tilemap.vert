@@ -0,0 +1,18 @@
+#version 150
+
+in vec2 position; // in tilemap space
+in vec2 texcell; // corner of atlas cell, in pixels
+
+out vec2 texcoord;
+
+uniform mat3 wmat;
+uniform mat3 inverse_view_matrix;
+
+uniform vec2 atlas_size;
+
+void main()
+{
+    gl_Position = vec4(inverse_view_matrix * wmat * vec3(position, 1.0), 1.0);
+    texcoord = texcell / atlas_size;
+}
+
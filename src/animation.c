@@ -0,0 +1,659 @@
+#include "animation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "array.h"
+#include "timing.h"
+#include "sprite.h"
+#include "soapool.h"
+
+typedef struct Anim Anim;
+struct Anim
+{
+    char *name;
+    char *after; /* NULL to loop */
+    unsigned int n; /* number of frames */
+
+    bool strip;
+    Scalar t; /* strip only */
+    Vec2 base; /* strip only */
+    unsigned int first; /* frame table only, index in row's frames */
+};
+
+/* a row's run of elements in one of the shared arrays below */
+typedef struct Span Span;
+struct Span
+{
+    unsigned int first, n;
+};
+
+/*
+ * per-entity state is a row in a SoaPool -- animation_update_all() only
+ * walks the curr and t columns, anims and frames are only touched when a
+ * frame ends
+ *
+ * anims and frame tables of all rows live in two shared arrays, each row
+ * having a span of each -- a span that grows and isn't at the end of its
+ * array moves to the end, the old place is counted as garbage and
+ * reclaimed by _compact(...) once it's most of the array
+ */
+static SoaPool *pool;
+static unsigned int anims_col; /* Span in all_anims */
+static unsigned int frames_col; /* Span in all_frames, all of the row's
+                                   frame tables back to back */
+static unsigned int curr_col; /* int, index in anims of current anim, -1 if
+                                 none */
+static unsigned int frame_col; /* unsigned int, index of current frame */
+static unsigned int t_col; /* Scalar, time left in current frame */
+
+static Array *all_anims; /* Anim */
+static Array *all_frames; /* AnimationFrame */
+static unsigned int anims_garbage = 0; /* elements in no span */
+static unsigned int frames_garbage = 0;
+
+#define _anims(row) soapool_get_val(Span, pool, anims_col, row)
+#define _frames(row) soapool_get_val(Span, pool, frames_col, row)
+#define _curr(row) soapool_get_val(int, pool, curr_col, row)
+#define _frame(row) soapool_get_val(unsigned int, pool, frame_col, row)
+#define _t(row) soapool_get_val(Scalar, pool, t_col, row)
+
+/* ------------------------------------------------------------------------- */
+
+/* add an element at end of span, returns its index in arr */
+static unsigned int _span_add(Array *arr, unsigned int *garbage,
+                              Span *span, size_t size)
+{
+    unsigned int first, i;
+
+    /* not at end of arr? move there, old place is garbage */
+    if (span->first + span->n != array_length(arr))
+    {
+        first = array_length(arr);
+        for (i = 0; i < span->n; ++i)
+            array_add(arr);
+        if (span->n > 0)
+            memcpy(array_get(arr, first), array_get(arr, span->first),
+                   span->n * size);
+        *garbage += span->n;
+        span->first = first;
+    }
+
+    array_add(arr);
+    return span->first + span->n++;
+}
+
+/* remove n elements of span starting at i, keeping the rest in order */
+static void _span_remove(Array *arr, unsigned int *garbage,
+                         Span *span, unsigned int i, unsigned int n,
+                         size_t size)
+{
+    char *begin;
+    unsigned int k;
+
+    if (n == 0)
+        return;
+
+    begin = array_get(arr, span->first);
+    memmove(begin + i * size, begin + (i + n) * size,
+            (span->n - i - n) * size);
+    span->n -= n;
+
+    /* freed tail is garbage unless at end of arr */
+    if (span->first + span->n + n == array_length(arr))
+        for (k = 0; k < n; ++k)
+            array_pop(arr);
+    else
+        *garbage += n;
+}
+
+/* copy spans back to back into a new array if mostly garbage */
+static void _compact(Array **arr, unsigned int *garbage,
+                     unsigned int col, size_t size)
+{
+    Array *old = *arr;
+    Span *spans;
+    unsigned int row, first, i;
+
+    if (*garbage == 0 || *garbage < array_length(old) / 2)
+        return;
+
+    *arr = array_new_(size);
+    spans = soapool_column(pool, col);
+    for (row = 0; row < soapool_size(pool); ++row)
+    {
+        first = array_length(*arr);
+        for (i = 0; i < spans[row].n; ++i)
+            array_add(*arr);
+        if (spans[row].n > 0)
+            memcpy(array_get(*arr, first), array_get(old, spans[row].first),
+                   spans[row].n * size);
+        spans[row].first = first;
+    }
+    array_free(old);
+    *garbage = 0;
+}
+
+static Anim *_anim(unsigned int row, unsigned int i)
+{
+    return array_get(all_anims, _anims(row).first + i);
+}
+static AnimationFrame *_anim_frame(unsigned int row, unsigned int i)
+{
+    return array_get(all_frames, _frames(row).first + i);
+}
+
+static unsigned int _get(Entity ent)
+{
+    int row = soapool_get(pool, ent);
+    error_assert(row >= 0, "entity must be in animation system");
+    return row;
+}
+
+static int _find(unsigned int row, const char *name)
+{
+    unsigned int i;
+
+    if (!name)
+        return -1;
+    for (i = 0; i < _anims(row).n; ++i)
+        if (!strcmp(_anim(row, i)->name, name))
+            return i;
+    return -1;
+}
+static Anim *_get_anim(unsigned int row, const char *name)
+{
+    int i = _find(row, name);
+    error_assert(i >= 0, "must have an animation with given name");
+    return _anim(row, i);
+}
+
+static void _set_str(char **dest, const char *src)
+{
+    char *copy = NULL;
+
+    if (src)
+    {
+        copy = malloc(strlen(src) + 1);
+        strcpy(copy, src);
+    }
+    free(*dest);
+    *dest = copy;
+}
+
+/* release anim's frame table, keeping the rest of them contiguous */
+static void _frames_remove(unsigned int row, Anim *anim)
+{
+    unsigned int i;
+    Anim *other;
+
+    if (anim->strip || anim->n == 0)
+        return;
+
+    _span_remove(all_frames, &frames_garbage, &_frames(row),
+                 anim->first, anim->n, sizeof(AnimationFrame));
+
+    for (i = 0; i < _anims(row).n; ++i)
+    {
+        other = _anim(row, i);
+        if (!other->strip && other->first > anim->first)
+            other->first -= anim->n;
+    }
+    anim->n = 0;
+}
+
+/* get anim with given name ready for new frames, add if needed */
+static Anim *_anim_reset(unsigned int row, const char *name)
+{
+    Anim *anim;
+    int i;
+
+    i = _find(row, name);
+    if (i >= 0)
+    {
+        anim = _anim(row, i);
+        _frames_remove(row, anim);
+        return anim;
+    }
+
+    anim = array_get(all_anims, _span_add(all_anims, &anims_garbage,
+                                          &_anims(row), sizeof(Anim)));
+    anim->name = NULL;
+    anim->after = NULL;
+    anim->n = 0;
+    anim->strip = true;
+    _set_str(&anim->name, name);
+    return anim;
+}
+
+static void _enter_frame(unsigned int row, unsigned int frame)
+{
+    Anim *anim;
+    AnimationFrame *f;
+    Entity ent;
+    Vec2 texcell;
+
+    ent = soapool_entities(pool)[row];
+    anim = _anim(row, _curr(row));
+    _frame(row) = frame;
+
+    if (anim->strip)
+    {
+        _t(row) = anim->t > 0 ? anim->t : 1;
+        if (!sprite_has(ent))
+            return; /* sprite was removed, just keep time */
+        texcell = anim->base;
+        texcell.x += frame * sprite_get_texsize(ent).x;
+        sprite_set_texcell(ent, texcell);
+    }
+    else
+    {
+        f = _anim_frame(row, anim->first + frame);
+        _t(row) = f->t > 0 ? f->t : 1;
+        if (!sprite_has(ent))
+            return;
+        if (f->set_texcell)
+            sprite_set_texcell(ent, f->texcell);
+        if (f->set_texsize)
+            sprite_set_texsize(ent, f->texsize);
+    }
+}
+
+/* go to next frame, following 'after' at the end */
+static void _next_frame(unsigned int row)
+{
+    Anim *anim;
+    int after;
+
+    anim = _anim(row, _curr(row));
+    if (_frame(row) + 1 < anim->n)
+    {
+        _enter_frame(row, _frame(row) + 1);
+        return;
+    }
+
+    if ((after = _find(row, anim->after)) >= 0)
+        _curr(row) = after;
+    _enter_frame(row, 0);
+}
+
+/* anim was changed, make sure current frame is still valid */
+static void _anim_changed(unsigned int row, Anim *anim)
+{
+    unsigned int frame;
+
+    if (_curr(row) < 0 || anim != _anim(row, _curr(row)))
+        return;
+
+    frame = _frame(row) < anim->n ? _frame(row) : 0;
+    _enter_frame(row, frame);
+}
+
+static void _add(Entity ent)
+{
+    unsigned int row;
+
+    if (soapool_get(pool, ent) >= 0)
+        return;
+
+    row = soapool_add(pool, ent);
+    _anims(row).first = _anims(row).n = 0;
+    _frames(row).first = _frames(row).n = 0;
+    _curr(row) = -1;
+    _frame(row) = 0;
+    _t(row) = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void animation_add(Entity ent)
+{
+    sprite_add(ent);
+    _add(ent);
+}
+void animation_remove(Entity ent)
+{
+    int row;
+    unsigned int i;
+    Anim *anim;
+
+    if ((row = soapool_get(pool, ent)) < 0)
+        return;
+
+    for (i = 0; i < _anims(row).n; ++i)
+    {
+        anim = _anim(row, i);
+        free(anim->name);
+        free(anim->after);
+    }
+    _span_remove(all_anims, &anims_garbage, &_anims(row),
+                 0, _anims(row).n, sizeof(Anim));
+    _span_remove(all_frames, &frames_garbage, &_frames(row),
+                 0, _frames(row).n, sizeof(AnimationFrame));
+    soapool_remove(pool, ent);
+}
+bool animation_has(Entity ent)
+{
+    return soapool_get(pool, ent) >= 0;
+}
+
+void animation_set_strip(Entity ent, const char *name,
+                         unsigned int n, Scalar t, Vec2 base)
+{
+    unsigned int row;
+    Anim *anim;
+
+    row = _get(ent);
+    anim = _anim_reset(row, name);
+    anim->strip = true;
+    anim->n = n > 0 ? n : 1;
+    anim->t = t;
+    anim->base = base;
+    _anim_changed(row, anim);
+}
+void animation_set_frames(Entity ent, const char *name,
+                          unsigned int n, const AnimationFrame *frames)
+{
+    unsigned int row, i;
+    Anim *anim;
+
+    error_assert(n > 0, "frame table must have at least one frame");
+
+    row = _get(ent);
+    anim = _anim_reset(row, name);
+    anim->strip = false;
+    anim->n = n;
+    anim->first = _frames(row).n;
+    for (i = 0; i < n; ++i)
+        array_get_val(AnimationFrame, all_frames,
+                      _span_add(all_frames, &frames_garbage, &_frames(row),
+                                sizeof(AnimationFrame))) = frames[i];
+    _anim_changed(row, anim);
+}
+void animation_remove_anim(Entity ent, const char *name)
+{
+    unsigned int row;
+    Anim *anim;
+    int i, last;
+
+    row = _get(ent);
+    if ((i = _find(row, name)) < 0)
+        return;
+
+    anim = _anim(row, i);
+    _frames_remove(row, anim);
+    free(anim->name);
+    free(anim->after);
+
+    /* last anim will be moved into removed one's place */
+    last = _anims(row).n - 1;
+    if (_curr(row) == i)
+        _curr(row) = -1;
+    else if (_curr(row) == last)
+        _curr(row) = i;
+    if (i != last)
+        *anim = *_anim(row, last);
+    _span_remove(all_anims, &anims_garbage, &_anims(row), last, 1,
+                 sizeof(Anim));
+}
+bool animation_has_anim(Entity ent, const char *name)
+{
+    return _find(_get(ent), name) >= 0;
+}
+
+void animation_set_after(Entity ent, const char *name, const char *after)
+{
+    _set_str(&_get_anim(_get(ent), name)->after, after);
+}
+const char *animation_get_after(Entity ent, const char *name)
+{
+    return _get_anim(_get(ent), name)->after;
+}
+
+unsigned int animation_get_num_anims(Entity ent)
+{
+    return _anims(_get(ent)).n;
+}
+const char *animation_get_nth_anim(Entity ent, unsigned int n)
+{
+    unsigned int row = _get(ent);
+    error_assert(n < _anims(row).n);
+    return _anim(row, n)->name;
+}
+
+bool animation_get_is_strip(Entity ent, const char *name)
+{
+    return _get_anim(_get(ent), name)->strip;
+}
+unsigned int animation_get_num_frames(Entity ent, const char *name)
+{
+    return _get_anim(_get(ent), name)->n;
+}
+Scalar animation_get_strip_t(Entity ent, const char *name)
+{
+    Anim *anim = _get_anim(_get(ent), name);
+    error_assert(anim->strip);
+    return anim->t;
+}
+Vec2 animation_get_strip_base(Entity ent, const char *name)
+{
+    Anim *anim = _get_anim(_get(ent), name);
+    error_assert(anim->strip);
+    return anim->base;
+}
+
+void animation_start(Entity ent, const char *name)
+{
+    unsigned int row = _get(ent);
+    _curr(row) = _find(row, name);
+    error_assert(_curr(row) >= 0, "must have an animation with given name");
+    _enter_frame(row, 0);
+}
+void animation_switch(Entity ent, const char *name)
+{
+    unsigned int row = _get(ent);
+    if (_curr(row) >= 0 && _curr(row) == _find(row, name))
+        return;
+    animation_start(ent, name);
+}
+const char *animation_get_curr_anim(Entity ent)
+{
+    unsigned int row = _get(ent);
+    if (_curr(row) < 0)
+        return NULL;
+    return _anim(row, _curr(row))->name;
+}
+unsigned int animation_get_frame(Entity ent)
+{
+    return _frame(_get(ent));
+}
+
+/* ------------------------------------------------------------------------- */
+
+void animation_init()
+{
+    pool = soapool_new();
+    anims_col = soapool_add_column(pool, Span);
+    frames_col = soapool_add_column(pool, Span);
+    curr_col = soapool_add_column(pool, int);
+    frame_col = soapool_add_column(pool, unsigned int);
+    t_col = soapool_add_column(pool, Scalar);
+
+    all_anims = array_new(Anim);
+    all_frames = array_new(AnimationFrame);
+}
+void animation_deinit()
+{
+    while (soapool_size(pool) > 0)
+        animation_remove(soapool_entities(pool)[0]);
+    soapool_free(pool);
+    array_free(all_frames);
+    array_free(all_anims);
+}
+
+void animation_update_all()
+{
+    unsigned int row, n;
+    int *curr;
+    Scalar *t, over;
+
+    soapool_remove_destroyed(pool, animation_remove);
+    _compact(&all_anims, &anims_garbage, anims_col, sizeof(Anim));
+    _compact(&all_frames, &frames_garbage, frames_col,
+             sizeof(AnimationFrame));
+
+    /*
+     * only touches sprites on frame changes -- _next_frame(...) doesn't
+     * add/remove rows, so the column pointers stay good
+     */
+    n = soapool_size(pool);
+    curr = soapool_column(pool, curr_col);
+    t = soapool_column(pool, t_col);
+    for (row = 0; row < n; ++row)
+        if (curr[row] >= 0)
+        {
+            t[row] -= timing_dt;
+            while (t[row] <= 0)
+            {
+                over = t[row];
+                _next_frame(row);
+                t[row] += over;
+            }
+        }
+}
+
+static void _anim_save(unsigned int row, Anim *anim, Store *anim_s)
+{
+    Store *frames_s, *frame_s;
+    AnimationFrame *f;
+    unsigned int i;
+
+    string_save((const char **) &anim->name, "name", anim_s);
+    string_save((const char **) &anim->after, "after", anim_s);
+    uint_save(&anim->n, "n", anim_s);
+    bool_save(&anim->strip, "strip", anim_s);
+    if (anim->strip)
+    {
+        scalar_save(&anim->t, "t", anim_s);
+        vec2_save(&anim->base, "base", anim_s);
+    }
+    else if (store_child_save(&frames_s, "frames", anim_s))
+        for (i = 0; i < anim->n; ++i)
+            if (store_child_save(&frame_s, NULL, frames_s))
+            {
+                f = _anim_frame(row, anim->first + i);
+                scalar_save(&f->t, "t", frame_s);
+                vec2_save(&f->texcell, "texcell", frame_s);
+                vec2_save(&f->texsize, "texsize", frame_s);
+                bool_save(&f->set_texcell, "set_texcell", frame_s);
+                bool_save(&f->set_texsize, "set_texsize", frame_s);
+            }
+}
+
+void animation_save_all(Store *s)
+{
+    Store *t, *pool_s, *animation_s, *anims_s, *anim_s;
+    Entity ent;
+    unsigned int row, i;
+    const char *curr;
+
+    if (store_child_save(&t, "animation", s)
+        && store_child_save(&pool_s, "pool", t))
+        for (row = 0; row < soapool_size(pool); ++row)
+        {
+            ent = soapool_entities(pool)[row];
+            if (!entity_get_save_filter(ent)
+                || !store_child_save(&animation_s, NULL, pool_s))
+                continue;
+            entity_save(&ent, "pool_elem", animation_s);
+
+            if (store_child_save(&anims_s, "anims", animation_s))
+                for (i = 0; i < _anims(row).n; ++i)
+                    if (store_child_save(&anim_s, NULL, anims_s))
+                        _anim_save(row, _anim(row, i), anim_s);
+
+            curr = animation_get_curr_anim(ent);
+            string_save(&curr, "curr", animation_s);
+            uint_save(&_frame(row), "frame", animation_s);
+            scalar_save(&_t(row), "t", animation_s);
+        }
+}
+
+static void _anim_load(unsigned int row, Store *anim_s)
+{
+    Store *frames_s, *frame_s;
+    Anim *anim;
+    AnimationFrame *f;
+    char *name;
+
+    string_load(&name, "name", "", anim_s);
+    anim = _anim_reset(row, name);
+    free(name);
+
+    free(anim->after);
+    string_load(&anim->after, "after", NULL, anim_s);
+    uint_load(&anim->n, "n", 1, anim_s);
+    bool_load(&anim->strip, "strip", true, anim_s);
+    if (anim->strip)
+    {
+        scalar_load(&anim->t, "t", 1, anim_s);
+        vec2_load(&anim->base, "base", vec2_zero, anim_s);
+        return;
+    }
+
+    anim->first = _frames(row).n;
+    anim->n = 0;
+    if (store_child_load(&frames_s, "frames", anim_s))
+        while (store_child_load(&frame_s, NULL, frames_s))
+        {
+            f = array_get(all_frames,
+                          _span_add(all_frames, &frames_garbage,
+                                    &_frames(row), sizeof(AnimationFrame)));
+            scalar_load(&f->t, "t", 1, frame_s);
+            vec2_load(&f->texcell, "texcell", vec2_zero, frame_s);
+            vec2_load(&f->texsize, "texsize", vec2(32, 32), frame_s);
+            bool_load(&f->set_texcell, "set_texcell", false, frame_s);
+            bool_load(&f->set_texsize, "set_texsize", false, frame_s);
+            ++anim->n;
+        }
+    if (anim->n == 0)
+        anim->strip = true; /* empty frame table, make it a harmless strip */
+}
+
+void animation_load_all(Store *s)
+{
+    Store *t, *pool_s, *animation_s, *anims_s, *anim_s;
+    Entity ent;
+    unsigned int row;
+    char *curr;
+    Scalar t_left;
+
+    if (store_child_load(&t, "animation", s)
+        && store_child_load(&pool_s, "pool", t))
+        while (store_child_load(&animation_s, NULL, pool_s))
+        {
+            /* replace whatever was there, anims are allocated per entity */
+            error_assert(entity_load(&ent, "pool_elem", entity_nil,
+                                     animation_s),
+                         "saved EntityPoolElem entry must exist");
+            animation_remove(ent);
+            _add(ent);
+            row = _get(ent);
+
+            if (store_child_load(&anims_s, "anims", animation_s))
+                while (store_child_load(&anim_s, NULL, anims_s))
+                    _anim_load(row, anim_s);
+
+            string_load(&curr, "curr", NULL, animation_s);
+            _curr(row) = _find(row, curr);
+            free(curr);
+            uint_load(&_frame(row), "frame", 0, animation_s);
+            if (_curr(row) >= 0)
+                _anim_changed(row, _anim(row, _curr(row)));
+
+            /* after entering frame, which resets time left */
+            if (scalar_load(&t_left, "t", 1, animation_s))
+                _t(row) = t_left;
+        }
+}
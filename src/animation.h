@@ -0,0 +1,75 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "saveload.h"
+#include "entity.h"
+#include "vec2.h"
+#include "script_export.h"
+
+/*
+ * sprite animation -- each entity has a set of named animations, one of
+ * which plays at a time by changing the entity's sprite texcell (and
+ * optionally texsize) at each frame
+ */
+
+SCRIPT(animation,
+
+       /* one frame of a frame table animation */
+       typedef struct AnimationFrame AnimationFrame;
+       struct AnimationFrame
+       {
+           Scalar t; /* duration in seconds, 1 if <= 0 */
+           Vec2 texcell;
+           Vec2 texsize;
+           bool set_texcell; /* whether entering frame changes texcell */
+           bool set_texsize; /* whether entering frame changes texsize */
+       };
+
+       EXPORT void animation_add(Entity ent); /* also adds sprite */
+       EXPORT void animation_remove(Entity ent);
+       EXPORT bool animation_has(Entity ent);
+
+       /*
+        * add or replace an animation -- a strip is n frames of t seconds
+        * each in a row on the atlas, going right from base in steps of
+        * the sprite's texsize, a frame table is an array of n frames
+        */
+       EXPORT void animation_set_strip(Entity ent, const char *anim,
+                                       unsigned int n, Scalar t, Vec2 base);
+       EXPORT void animation_set_frames(Entity ent, const char *anim,
+                                        unsigned int n,
+                                        const AnimationFrame *frames);
+       EXPORT void animation_remove_anim(Entity ent, const char *anim);
+       EXPORT bool animation_has_anim(Entity ent, const char *anim);
+
+       /* animation to go to after last frame of anim, NULL to loop */
+       EXPORT void animation_set_after(Entity ent, const char *anim,
+                                       const char *after);
+       EXPORT const char *animation_get_after(Entity ent, const char *anim);
+
+       /* to iterate over animations of ent */
+       EXPORT unsigned int animation_get_num_anims(Entity ent);
+       EXPORT const char *animation_get_nth_anim(Entity ent, unsigned int n);
+
+       EXPORT bool animation_get_is_strip(Entity ent, const char *anim);
+       EXPORT unsigned int animation_get_num_frames(Entity ent,
+                                                    const char *anim);
+       EXPORT Scalar animation_get_strip_t(Entity ent, const char *anim);
+       EXPORT Vec2 animation_get_strip_base(Entity ent, const char *anim);
+
+       /* start anim from first frame, switch doesn't if already playing */
+       EXPORT void animation_start(Entity ent, const char *anim);
+       EXPORT void animation_switch(Entity ent, const char *anim);
+       EXPORT const char *animation_get_curr_anim(Entity ent); /* or NULL */
+       EXPORT unsigned int animation_get_frame(Entity ent);
+
+    )
+
+void animation_init();
+void animation_deinit();
+void animation_update_all();
+void animation_save_all(Store *s);
+void animation_load_all(Store *s);
+
+#endif
+
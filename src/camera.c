@@ -19,6 +19,11 @@ static Entity curr_camera;
 static Entity edit_camera;
 
 static Mat3 inverse_view_matrix; /* cached inverse view matrix */
+static BBox view_bbox; /* world-space bbox around view, for culling */
+
+/* culling stats, counted this frame and last frame */
+static unsigned int num_culled, num_drawn;
+static unsigned int last_num_culled, last_num_drawn;
 
 static EntityPool *pool;
 
@@ -50,6 +55,10 @@ bool camera_has(Entity ent)
 {
     return entitypool_get(pool, ent) != NULL;
 }
+EntityPool *camera_get_pool()
+{
+    return pool;
+}
 
 void camera_set_edit_camera(Entity ent)
 {
@@ -122,6 +131,26 @@ Vec2 camera_unit_to_world(Vec2 p)
     return p;
 }
 
+bool camera_in_view(BBox b)
+{
+    if (b.max.x < view_bbox.min.x || b.min.x > view_bbox.max.x
+        || b.max.y < view_bbox.min.y || b.min.y > view_bbox.max.y)
+    {
+        ++num_culled;
+        return false;
+    }
+    ++num_drawn;
+    return true;
+}
+unsigned int camera_get_num_culled()
+{
+    return last_num_culled;
+}
+unsigned int camera_get_num_drawn()
+{
+    return last_num_drawn;
+}
+
 /* ------------------------------------------------------------------------- */
 
 void camera_init()
@@ -130,6 +159,8 @@ void camera_init()
     curr_camera = entity_nil;
     edit_camera = entity_nil;
     inverse_view_matrix = mat3_identity();
+    view_bbox = bbox(vec2(-1, -1), vec2(1, 1));
+    num_culled = num_drawn = last_num_culled = last_num_drawn = 0;
 }
 void camera_deinit()
 {
@@ -159,11 +190,23 @@ void camera_update_all()
         edit_bboxes_update(camera->pool_elem.ent, bbox);
     }
 
+    /* view is the unit box in camera space */
     cam = camera_get_current_camera();
     if (entity_eq(cam, entity_nil))
+    {
         inverse_view_matrix = mat3_identity();
+        view_bbox = bbox;
+    }
     else
+    {
         inverse_view_matrix = mat3_inverse(transform_get_world_matrix(cam));
+        view_bbox = bbox_transform(transform_get_world_matrix(cam), bbox);
+    }
+
+    /* culling stats were for last frame's draw */
+    last_num_culled = num_culled;
+    last_num_drawn = num_drawn;
+    num_culled = num_drawn = 0;
 }
 
 void camera_save_all(Store *s)
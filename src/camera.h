@@ -3,8 +3,10 @@
 
 #include "saveload.h"
 #include "entity.h"
+#include "entitypool.h"
 #include "vec2.h"
 #include "mat3.h"
+#include "bbox.h"
 #include "script_export.h"
 
 /*
@@ -17,6 +19,7 @@ SCRIPT(camera,
        EXPORT void camera_add(Entity ent);
        EXPORT void camera_remove(Entity ent);
        EXPORT bool camera_has(Entity ent);
+       EXPORT EntityPool *camera_get_pool(); /* for entitypool_join_*() */
 
        /* set camera to use in edit mode -- not saved/loaded */
        EXPORT void camera_set_edit_camera(Entity ent);
@@ -39,6 +42,14 @@ SCRIPT(camera,
        EXPORT Vec2 camera_pixels_to_world(Vec2 p);
        EXPORT Vec2 camera_unit_to_world(Vec2 p);
 
+       /*
+        * culling -- whether world-space box b may be seen through current
+        * camera, each call counts towards the stats below
+        */
+       EXPORT bool camera_in_view(BBox b);
+       EXPORT unsigned int camera_get_num_culled(); /* in last frame */
+       EXPORT unsigned int camera_get_num_drawn(); /* in last frame */
+
     )
 
 const Mat3 *camera_get_inverse_view_matrix_ptr(); /* for quick GLSL binding */
@@ -9,6 +9,7 @@
 
 #include "scalar.h"
 #include "game.h"
+#include "headless.h"
 #include "saveload.h"
 #include "vec2.h"
 #include "mat3.h"
@@ -16,14 +17,19 @@
 #include "color.h"
 #include "fs.h"
 #include "system.h"
+#include "frame.h"
 #include "input.h"
 #include "entity.h"
+#include "entitypool.h"
 #include "prefab.h"
 #include "timing.h"
 #include "transform.h"
 #include "camera.h"
 #include "gui.h"
 #include "sprite.h"
+#include "animation.h"
+#include "tilemap.h"
+#include "particle.h"
 #include "console.h"
 #include "sound.h"
 #include "physics.h"
@@ -49,14 +55,20 @@ static const char **cgame_ffi[] =
     &cgame_ffi_color,
     &cgame_ffi_fs,
     &cgame_ffi_game,
+    &cgame_ffi_headless,
     &cgame_ffi_system,
+    &cgame_ffi_frame,
     &cgame_ffi_input,
     &cgame_ffi_entity,
+    &cgame_ffi_entitypool,
     &cgame_ffi_prefab,
     &cgame_ffi_timing,
     &cgame_ffi_transform,
     &cgame_ffi_camera,
     &cgame_ffi_sprite,
+    &cgame_ffi_animation,
+    &cgame_ffi_tilemap,
+    &cgame_ffi_particle,
     &cgame_ffi_gui,
     &cgame_ffi_console,
     &cgame_ffi_sound,
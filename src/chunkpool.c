@@ -0,0 +1,270 @@
+#include "chunkpool.h"
+
+#include <stdlib.h>
+
+#include "entitymap.h"
+#include "array.h"
+#include "error.h"
+
+#define CHUNK_BITS 8
+#define CHUNK_SIZE (1 << CHUNK_BITS)      /* number of slots per chunk */
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+struct ChunkPool
+{
+    EntityMap *emap;         /* Entity -> slot, -1 if doesn't exist */
+
+    Array *chunks;           /* char * per chunk of CHUNK_SIZE slots */
+    Array *free_slots;       /* unsigned int per hole, reused latest first */
+    unsigned int nslots;     /* number of slots in use (elements + holes) */
+    unsigned int size;       /* number of elements */
+
+    size_t object_size;
+};
+
+ChunkPool *chunkpool_new_(size_t object_size)
+{
+    ChunkPool *pool = malloc(sizeof(ChunkPool));
+
+    error_assert(object_size >= sizeof(EntityPoolElem));
+
+    pool->emap = entitymap_new(-1);
+    pool->chunks = array_new(char *);
+    pool->free_slots = array_new(unsigned int);
+    pool->nslots = 0;
+    pool->size = 0;
+    pool->object_size = object_size;
+
+    return pool;
+}
+void chunkpool_free(ChunkPool *pool)
+{
+    chunkpool_clear(pool);
+    array_free(pool->free_slots);
+    array_free(pool->chunks);
+    entitymap_free(pool->emap);
+    free(pool);
+}
+
+void *chunkpool_add(ChunkPool *pool, Entity ent)
+{
+    int i;
+    unsigned int slot;
+    EntityPoolElem *elem;
+
+    if ((elem = chunkpool_get(pool, ent)))
+        return elem;
+
+    /* stale element from an older generation of this index? drop it */
+    i = entitymap_get(pool->emap, ent);
+    if (i >= 0)
+    {
+        elem = chunkpool_slot(pool, i);
+        chunkpool_remove(pool, elem->ent);
+    }
+
+    /* fill a hole if we have one, else take a new slot */
+    if (array_length(pool->free_slots) > 0)
+    {
+        slot = array_top_val(unsigned int, pool->free_slots);
+        array_pop(pool->free_slots);
+    }
+    else
+    {
+        slot = pool->nslots++;
+        if ((slot >> CHUNK_BITS) >= array_length(pool->chunks))
+            array_add_val(char *, pool->chunks)
+                = malloc(CHUNK_SIZE * pool->object_size);
+    }
+
+    elem = chunkpool_slot(pool, slot);
+    elem->ent = ent;
+    entitymap_set(pool->emap, ent, slot);
+    ++pool->size;
+    return elem;
+}
+void chunkpool_remove(ChunkPool *pool, Entity ent)
+{
+    int i;
+    EntityPoolElem *elem;
+
+    i = entitymap_get(pool->emap, ent);
+    if (i >= 0)
+    {
+        /* ignore if mapped element is of another generation */
+        elem = chunkpool_slot(pool, i);
+        if (!entity_eq(elem->ent, ent))
+            return;
+
+        /* leave a hole */
+        elem->ent = entity_nil;
+        entitymap_set(pool->emap, ent, -1);
+        --pool->size;
+
+        /*
+         * if empty start over from slot 0 but keep the chunks, so that
+         * add/remove of a single element doesn't allocate each time --
+         * memory is given back by chunkpool_clear(...), else remember hole
+         */
+        if (pool->size == 0)
+        {
+            while (array_length(pool->free_slots) > 0)
+                array_pop(pool->free_slots);
+            pool->nslots = 0;
+        }
+        else
+            array_add_val(unsigned int, pool->free_slots) = i;
+    }
+}
+void *chunkpool_get(ChunkPool *pool, Entity ent)
+{
+    int i;
+    EntityPoolElem *elem;
+
+    i = entitymap_get(pool->emap, ent);
+    if (i >= 0)
+    {
+        /* index may be mapped for another generation */
+        elem = chunkpool_slot(pool, i);
+        if (entity_eq(elem->ent, ent))
+            return elem;
+    }
+    return NULL;
+}
+
+unsigned int chunkpool_size(ChunkPool *pool)
+{
+    return pool->size;
+}
+
+unsigned int chunkpool_num_slots(ChunkPool *pool)
+{
+    return pool->nslots;
+}
+void *chunkpool_slot(ChunkPool *pool, unsigned int i)
+{
+    char *chunk = array_get_val(char *, pool->chunks, i >> CHUNK_BITS);
+    return chunk + (i & CHUNK_MASK) * pool->object_size;
+}
+
+void chunkpool_clear(ChunkPool *pool)
+{
+    char **chunk;
+
+    array_foreach(chunk, pool->chunks)
+        free(*chunk);
+    array_clear(pool->chunks);
+    array_clear(pool->free_slots);
+    entitymap_clear(pool->emap);
+    pool->nslots = 0;
+    pool->size = 0;
+}
+
+void chunkpool_elem_save(ChunkPool *pool, void *elem, Store *s)
+{
+    EntityPoolElem **p;
+
+    /* save Entity id */
+    p = elem;
+    entity_save(&(*p)->ent, "pool_elem", s);
+}
+void chunkpool_elem_load(ChunkPool *pool, void *elem, Store *s)
+{
+    Entity ent;
+    EntityPoolElem **p;
+
+    /* load Entity id, add element with that key */
+    error_assert(entity_load(&ent, "pool_elem", entity_nil, s),
+                 "saved EntityPoolElem entry must exist");
+    p = elem;
+    *p = chunkpool_add(pool, ent);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef CHUNKPOOL_TEST
+
+#include <stdio.h>
+
+typedef struct Elem Elem;
+struct Elem
+{
+    EntityPoolElem pool_elem;
+    int x;
+};
+
+static ChunkPool *pool;
+
+void dump()
+{
+    Elem *elem;
+
+    printf("{ (%u, %u) -- ", chunkpool_size(pool), chunkpool_num_slots(pool));
+    chunkpool_foreach(elem, pool)
+        printf("(%u: %d) ", elem->pool_elem.ent.id, elem->x);
+    printf("}\n");
+}
+
+int main()
+{
+    unsigned int i;
+    Entity ents[600];
+    Elem *elems[600], *elem;
+    char *chunk;
+
+    entity_init();
+    pool = chunkpool_new(Elem);
+
+    for (i = 0; i < 5; ++i)
+    {
+        ents[i] = entity_create();
+        elems[i] = chunkpool_add(pool, ents[i]);
+        elems[i]->x = i * 10;
+    }
+    dump();
+
+    /* removing leaves a hole, the next add fills it */
+    chunkpool_remove(pool, ents[1]);
+    dump();
+    ents[1] = entity_create();
+    elem = chunkpool_add(pool, ents[1]);
+    elem->x = 99;
+    printf("hole filled: %d\n", elem == elems[1]);
+    dump();
+
+    /* growing past a chunk doesn't move existing elements */
+    for (i = 5; i < 600; ++i)
+    {
+        ents[i] = entity_create();
+        elems[i] = chunkpool_add(pool, ents[i]);
+        elems[i]->x = i * 10;
+    }
+    printf("after grow: size %u, same place %d, x %d\n",
+           chunkpool_size(pool), elems[4] == chunkpool_get(pool, ents[4]),
+           elems[4]->x);
+
+    /* emptying keeps chunks around for reuse */
+    for (i = 0; i < 600; ++i)
+        chunkpool_remove(pool, ents[i]);
+    chunk = array_get_val(char *, pool->chunks, 0);
+    dump();
+    for (i = 0; i < 1000; ++i)
+    {
+        ents[0] = entity_create();
+        chunkpool_add(pool, ents[0]);
+        chunkpool_remove(pool, ents[0]);
+    }
+    printf("after add/remove cycles: %u chunks, first same %d\n",
+           array_length(pool->chunks),
+           chunk == array_get_val(char *, pool->chunks, 0));
+
+    chunkpool_clear(pool);
+    printf("after clear: %u chunks\n", array_length(pool->chunks));
+
+    chunkpool_free(pool);
+    entity_deinit();
+
+    return 0;
+}
+
+#endif
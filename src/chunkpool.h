@@ -0,0 +1,96 @@
+#ifndef CHUNKPOOL_H
+#define CHUNKPOOL_H
+
+#include <stddef.h>
+
+#include "entity.h"
+#include "entitypool.h"
+#include "saveload.h"
+
+/*
+ * like EntityPool, but elements never move: they're kept in fixed-size
+ * chunks that aren't relocated as the pool grows, and removing leaves a
+ * hole that a later add fills -- so element pointers stay valid until
+ * that element is removed and can be kept around
+ *
+ * elements must start with an EntityPoolElem just as with EntityPool,
+ * holes have pool_elem.ent == entity_nil
+ *
+ * since there are holes, iterate with chunkpool_foreach(...) rather than
+ * with pointers
+ */
+
+typedef struct ChunkPool ChunkPool;
+
+/* object_size is size per element */
+ChunkPool *chunkpool_new_(size_t object_size);
+#define chunkpool_new(type) chunkpool_new_(sizeof(type))
+void chunkpool_free(ChunkPool *pool);
+
+void *chunkpool_add(ChunkPool *pool, Entity ent);
+void chunkpool_remove(ChunkPool *pool, Entity ent);
+void *chunkpool_get(ChunkPool *pool, Entity ent); /* NULL if not mapped */
+
+unsigned int chunkpool_size(ChunkPool *pool); /* number of elements */
+
+/* slots are elements or holes, numbered from 0 */
+unsigned int chunkpool_num_slots(ChunkPool *pool);
+void *chunkpool_slot(ChunkPool *pool, unsigned int i);
+
+/*
+ * chunks are kept when the pool empties, this gives back their memory
+ */
+void chunkpool_clear(ChunkPool *pool);
+
+/* elem must be /pointer to/ pointer to element */
+void chunkpool_elem_save(ChunkPool *pool, void *elem, Store *s);
+void chunkpool_elem_load(ChunkPool *pool, void *elem, Store *s);
+
+/* same as entitypool_remove_destroyed(...) */
+#define chunkpool_remove_destroyed(pool, func)                  \
+    do                                                          \
+    {                                                           \
+        unsigned int __i;                                       \
+        Entity __ent;                                           \
+        for (__i = 0; __i < entity_get_num_destroyed(); ++__i)  \
+        {                                                       \
+            __ent = entity_get_nth_destroyed(__i);              \
+            if (chunkpool_get(pool, __ent))                     \
+                func(__ent);                                    \
+        }                                                       \
+    } while (0)
+
+/*
+ * can be used as:
+ *
+ *     chunkpool_foreach(var, pool)
+ *         ... use var ...
+ *
+ * here var must name a variable of type 'pointer to element' declared
+ * before -- unlike with EntityPool, elements may be added/removed while
+ * iterating, elements added may or may not be visited
+ *
+ * elements are visited in order of increasing slot
+ */
+#define chunkpool_foreach(var, pool)                                    \
+    for (unsigned int __i = 0; __i < chunkpool_num_slots(pool); ++__i)  \
+        if (!entity_eq(((EntityPoolElem *)                              \
+                        (var = chunkpool_slot(pool, __i)))->ent,        \
+                       entity_nil))
+
+/* same as entitypool_save_foreach(...) and entitypool_load_foreach(...) */
+#define chunkpool_save_foreach(var, var_s, pool, n, s)                  \
+    for (Store *pool##_s__ = NULL;                                      \
+         !pool##_s__ && store_child_save(&pool##_s__, n, s); )          \
+        chunkpool_foreach(var, pool)                                    \
+            if (entity_get_save_filter(((EntityPoolElem *) var)->ent))  \
+                if (store_child_save(&var_s, NULL, pool##_s__))         \
+                    if ((chunkpool_elem_save(pool, &var, var_s)), 1)
+#define chunkpool_load_foreach(var, var_s, pool, n, s)          \
+    for (Store *pool##_s__ = NULL;                              \
+         !pool##_s__ && store_child_load(&pool##_s__, n, s); )  \
+        while (store_child_load(&var_s, NULL, pool##_s__))      \
+            if ((chunkpool_elem_load(pool, &var, var_s)), 1)
+
+#endif
+
@@ -11,6 +11,7 @@
 #include "input.h"
 #include "gui.h"
 #include "transform.h"
+#include "frame.h"
 
 #define LINE_LEN 128 /* including newline, null char */
 #define NUM_LINES 20
@@ -159,11 +160,10 @@ void console_printf(const char *fmt, ...)
     va_end(ap2);
 
     /* allocate, sprintf, print */
-    s = malloc(n + 1);
+    s = frame_alloc(n + 1);
     vsprintf(s, fmt, ap1);
     va_end(ap1);
     _print(s);
-    free(s);
 }
 
 void console_init()
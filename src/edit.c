@@ -13,6 +13,7 @@
 #include "input.h"
 #include "game.h"
 #include "array.h"
+#include "frame.h"
 
 static bool enabled;
 
@@ -219,11 +220,13 @@ Vec2 edit_get_grid_size()
     return grid_size;
 }
 
-static Array *grid_cells; /* bboxes used for drawing grid */
-
-static void _grid_create_cells()
+/*
+ * fill cells with bboxes used for drawing grid, returns number of cells --
+ * if cells is NULL just counts
+ */
+static unsigned int _grid_create_cells(BBoxPoolElem *cells)
 {
-    BBoxPoolElem *cell;
+    unsigned int ncells;
     BBox cbox, cellbox;
     Entity camera;
     Vec2 cur, csize;
@@ -263,29 +266,27 @@ static void _grid_create_cells()
         cbox.min.y -= 0.5;
 
     /* fill in with grid cells */
+    ncells = 0;
     for (cur.x = cbox.min.x; cur.x < cbox.max.x; cur.x += cellbox.max.x)
         for (cur.y = cbox.min.y; cur.y < cbox.max.y; cur.y += cellbox.max.y)
         {
-            cell = array_add(grid_cells);
-            cell->bbox = cellbox;
-            cell->wmat = mat3_scaling_rotation_translation(vec2(1, 1), 0, cur);
-            cell->selected = 0;
+            if (cells)
+            {
+                cells[ncells].bbox = cellbox;
+                cells[ncells].wmat = mat3_scaling_rotation_translation(
+                    vec2(1, 1), 0, cur);
+                cells[ncells].selected = 0;
+            }
+            ++ncells;
         }
-}
-
-static void _grid_init()
-{
-    grid_cells = array_new(BBoxPoolElem);
-}
-static void _grid_deinit()
-{
-    array_free(grid_cells);
+    return ncells;
 }
 
 static void _grid_draw()
 {
     Vec2 win;
     unsigned int ncells;
+    BBoxPoolElem *cells;
 
     glUseProgram(bboxes_program);
     glUniformMatrix3fv(glGetUniformLocation(bboxes_program,
@@ -297,14 +298,14 @@ static void _grid_draw()
                 win.x / win.y);
     glUniform1f(glGetUniformLocation(bboxes_program, "is_grid"), 1);
 
-    _grid_create_cells();
+    ncells = _grid_create_cells(NULL);
+    cells = frame_alloc(ncells * sizeof(BBoxPoolElem));
+    _grid_create_cells(cells);
     glBindVertexArray(bboxes_vao);
     glBindBuffer(GL_ARRAY_BUFFER, bboxes_vbo);
-    ncells = array_length(grid_cells);
     glBufferData(GL_ARRAY_BUFFER, ncells * sizeof(BBoxPoolElem),
-                 array_begin(grid_cells), GL_STREAM_DRAW);
+                 cells, GL_STREAM_DRAW);
     glDrawArrays(GL_POINTS, 0, ncells);
-    array_clear(grid_cells);
 }
 
 /* --- line ---------------------------------------------------------------- */
@@ -402,13 +403,11 @@ void edit_init()
     uneditable_pool = entitypool_new(EntityPoolElem);
 
     _bboxes_init();
-    _grid_init();
     _line_init();
 }
 void edit_deinit()
 {
     _line_deinit();
-    _grid_deinit();
     _bboxes_deinit();
 
     entitypool_free(uneditable_pool);
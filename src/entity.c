@@ -8,15 +8,26 @@
 #include "entitypool.h"
 #include "error.h"
 
-typedef struct DestroyEntry DestroyEntry;
-struct DestroyEntry
+/* don't recycle indices until at least this many are free */
+#define MIN_FREE_INDICES 1024
+
+typedef enum SaveFilter SaveFilter;
+enum SaveFilter
 {
-    Entity ent;
-    unsigned int pass;
+    SF_SAVE,    /* save this Entity */
+    SF_NO_SAVE, /* do not save this Entity */
+    SF_UNSET,   /* filter wasn't set -- use default */
+};
+
+/* per-index info */
+typedef struct EntitySlot EntitySlot;
+struct EntitySlot
+{
+    unsigned int generation; /* generation of the current Entity */
+    SaveFilter save_filter;
 };
 
 Entity entity_nil = { 0 };
-static unsigned int counter = 1;
 
 typedef struct ExistsPoolElem ExistsPoolElem;
 struct ExistsPoolElem
@@ -26,63 +37,103 @@ struct ExistsPoolElem
 
 static EntityPool *exists_pool; /* all existing entities */
 
-static EntityMap *destroyed_map; /* whether entity is destroyed */
-static Array *destroyed; /* array of DestroyEntry for destroyed objects */
+static Array *slots; /* EntitySlot per index, index 0 is entity_nil's */
 
-static EntityMap *unused_map; /* whether has entry in unused array */
-static Array *unused; /* id put here after _remove(), can reuse */
+/*
+ * free indices form a queue so that a destroyed index is reused as late
+ * as possible -- released indices are pushed on free_in, claimed ones
+ * are popped off free_out, free_in is moved over when free_out runs out
+ */
+static Array *free_in;
+static Array *free_out;
+
+static Array *destroyed; /* Entity destroyed this frame */
+static Array *releasing; /* Entity destroyed last frame */
 
 static EntityMap *load_map; /* map of saved ids --> real ids */
+static EntityMap *load_saved_map; /* map of saved ids --> full saved id */
 
-typedef enum SaveFilter SaveFilter;
-enum SaveFilter
-{
-    SF_SAVE,    /* save this Entity */
-    SF_NO_SAVE, /* do not save this Entity */
-    SF_UNSET,   /* filter wasn't set -- use default */
-};
-static EntityMap *save_filter_map;
 static SaveFilter save_filter_default = SF_SAVE;
 
 /*
  * life cycle
  * ----------
  *
- *     (1) doesn't exist (or removed):
- *         destroyed_map[ent] = false
- *         ent not in destroyed
+ *     (1) free:
+ *         index in free_in or free_out (or never used)
  *
  *         on entity_create() go to exists
  *
  *     (2) exists:
- *         destroyed_map[ent] = false
- *         ent not in destroyed
+ *         slot generation == entity_generation(ent)
+ *         ent in exists_pool
  *
  *         on entity_destroy() go to destroyed
  *
  *     (3) destroyed:
- *         destroyed_map[ent] = true
- *         { ent, pass } in destroyed
+ *         slot generation != entity_generation(ent)
+ *         ent in destroyed, then in releasing on next update
  *
- *         each update if ++pass >= 2, _remove() (go to (1) "doesn't exist")
+ *         update after that pushes the index on free_in (go to (1))
+ *
+ * the delay before release gives each system an update in which to drop
+ * the destroyed Entity from its pools, since pools are keyed by index
  */
 
 /* ------------------------------------------------------------------------- */
 
-static Entity _generate_id()
+static inline Entity _make(unsigned int index, unsigned int generation)
 {
     Entity ent;
+    ent.id = (generation << ENTITY_INDEX_BITS) | index;
+    return ent;
+}
+
+static inline EntitySlot *_slot(unsigned int index)
+{
+    return array_get(slots, index);
+}
 
-    /* compute new id */
-    if (array_length(unused) > 0)
+static unsigned int _claim_index()
+{
+    unsigned int index;
+    EntitySlot *slot;
+
+    /* queue up free indices if we have enough */
+    if (array_length(free_out) == 0
+        && array_length(free_in) >= MIN_FREE_INDICES)
+        while (array_length(free_in) > 0)
+        {
+            array_add_val(unsigned int, free_out)
+                = array_top_val(unsigned int, free_in);
+            array_pop(free_in);
+        }
+
+    /* reuse oldest free index, or make a new one */
+    if (array_length(free_out) > 0)
     {
-        /* have an unused id -- claim it */
-        ent = array_top_val(Entity, unused);
-        entitymap_set(unused_map, ent, false);
-        array_pop(unused);
+        index = array_top_val(unsigned int, free_out);
+        array_pop(free_out);
+        return index;
     }
-    else
-        ent.id = counter++;
+
+    index = array_length(slots);
+    error_assert(index <= ENTITY_INDEX_MASK, "too many entities");
+    slot = array_add(slots);
+    slot->generation = 0;
+    return index;
+}
+
+static Entity _generate_id()
+{
+    unsigned int index;
+    EntitySlot *slot;
+    Entity ent;
+
+    index = _claim_index();
+    slot = _slot(index);
+    slot->save_filter = SF_UNSET;
+    ent = _make(index, slot->generation);
     error_assert(!entity_eq(ent, entity_nil));
 
     entitypool_add(exists_pool, ent);
@@ -98,63 +149,105 @@ Entity entity_create()
     return ent;
 }
 
-/* actually remove an entity entirely */
-static void _remove(Entity ent)
+/* invalidate ent and note it in list to release later */
+static void _destroy(Entity ent, Array *list)
 {
-    /* move it from destroyed to unused list */
-    entitymap_set(destroyed_map, ent, false);
-    array_add_val(Entity, unused) = ent;
-    entitymap_set(unused_map, ent, true);
+    EntitySlot *slot;
+
+    entitypool_remove(exists_pool, ent);
+
+    slot = _slot(entity_index(ent));
+    slot->generation = (slot->generation + 1) & ENTITY_GENERATION_MASK;
+    array_add_val(Entity, list) = ent;
 }
 
 void entity_destroy(Entity ent)
 {
-    if (!entitypool_get(exists_pool, ent))
-        return;
-    if (entitymap_get(unused_map, ent))
+    if (entity_eq(ent, entity_nil) || entity_destroyed(ent))
         return;
-    if (entitymap_get(destroyed_map, ent))
-        return; /* already noted */
+    _destroy(ent, destroyed);
+}
 
-    entitypool_remove(exists_pool, ent);
+void entity_create_n(unsigned int n, Entity *ents)
+{
+    unsigned int i;
 
-    /* mark it as destroyed but don't 'remove' it yet */
-    entitymap_set(destroyed_map, ent, true);
-    array_add_val(DestroyEntry, destroyed) = (DestroyEntry) { { ent.id }, 0 };
+    for (i = 0; i < n; ++i)
+        ents[i] = _generate_id();
+}
+void entity_destroy_n(unsigned int n, const Entity *ents)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; ++i)
+        entity_destroy(ents[i]);
 }
 
 void entity_destroy_all()
 {
     ExistsPoolElem *exists;
-    entitypool_foreach(exists, exists_pool)
+
+    /* entity_destroy() removes from exists_pool, so go from the end */
+    while (entitypool_size(exists_pool) > 0)
+    {
+        exists = entitypool_nth(exists_pool, entitypool_size(exists_pool) - 1);
         entity_destroy(exists->pool_elem.ent);
+    }
 }
 
 bool entity_destroyed(Entity ent)
 {
-    return entitymap_get(destroyed_map, ent);
+    unsigned int index = entity_index(ent);
+
+    if (index >= array_length(slots))
+        return true;
+    return _slot(index)->generation != entity_generation(ent);
+}
+
+unsigned int entity_get_num_destroyed()
+{
+    return array_length(releasing) + array_length(destroyed);
+}
+Entity entity_get_nth_destroyed(unsigned int n)
+{
+    unsigned int nreleasing;
+
+    error_assert(n < entity_get_num_destroyed());
+    nreleasing = array_length(releasing);
+    if (n < nreleasing)
+        return array_get_val(Entity, releasing, n);
+    return array_get_val(Entity, destroyed, n - nreleasing);
 }
 
 void entity_set_save_filter(Entity ent, bool filter)
 {
+    if (entity_destroyed(ent))
+        return;
+
     if (filter)
     {
-        entitymap_set(save_filter_map, ent, SF_SAVE);
+        _slot(entity_index(ent))->save_filter = SF_SAVE;
         save_filter_default = SF_NO_SAVE;
     }
     else
-        entitymap_set(save_filter_map, ent, SF_NO_SAVE);
+        _slot(entity_index(ent))->save_filter = SF_NO_SAVE;
 }
 bool entity_get_save_filter(Entity ent)
 {
-    SaveFilter filter = entitymap_get(save_filter_map, ent);
+    SaveFilter filter = SF_UNSET;
+
+    if (entity_index(ent) < array_length(slots))
+        filter = _slot(entity_index(ent))->save_filter;
     if (filter == SF_UNSET)
         filter = save_filter_default; /* not set, use default */
     return filter == SF_SAVE;
 }
 void entity_clear_save_filters()
 {
-    entitymap_clear(save_filter_map);
+    EntitySlot *slot;
+
+    array_foreach(slot, slots)
+        slot->save_filter = SF_UNSET;
     save_filter_default = SF_SAVE;
 }
 
@@ -162,43 +255,43 @@ void entity_clear_save_filters()
 
 void entity_init()
 {
+    EntitySlot *slot;
+
     exists_pool = entitypool_new(ExistsPoolElem);
-    destroyed_map = entitymap_new(false);
-    destroyed = array_new(DestroyEntry);
-    unused_map = entitymap_new(false);
-    unused = array_new(Entity);
-    save_filter_map = entitymap_new(SF_UNSET);
+    destroyed = array_new(Entity);
+    releasing = array_new(Entity);
+    free_in = array_new(unsigned int);
+    free_out = array_new(unsigned int);
+
+    /* reserve index of entity_nil */
+    slots = array_new(EntitySlot);
+    slot = array_add(slots);
+    slot->generation = entity_generation(entity_nil);
+    slot->save_filter = SF_UNSET;
 }
 void entity_deinit()
 {
-    entitymap_free(save_filter_map);
-    array_free(unused);
-    entitymap_free(unused_map);
+    array_free(slots);
+    array_free(free_out);
+    array_free(free_in);
+    array_free(releasing);
     array_free(destroyed);
-    entitymap_free(destroyed_map);
     entitypool_free(exists_pool);
 }
 
 void entity_update_all()
 {
-    unsigned int i;
-    DestroyEntry *entry;
+    Entity *ent;
+    Array *tmp;
 
-    /* check destroyeds -- first pass we let go, second pass we remove */
-    for (i = 0; i < array_length(destroyed); )
-    {
-        entry = array_get(destroyed, i);
-        if (entry->pass == 0)
-        {
-            ++entry->pass;
-            ++i;
-        }
-        else
-        {
-            _remove(entry->ent);
-            array_quick_remove(destroyed, i);
-        }
-    }
+    /* release last frame's destroyed, this frame's wait for next update */
+    array_foreach(ent, releasing)
+        array_add_val(unsigned int, free_in) = entity_index(*ent);
+    array_clear(releasing);
+
+    tmp = releasing;
+    releasing = destroyed;
+    destroyed = tmp;
 }
 
 void entity_save(Entity *ent, const char *n, Store *s)
@@ -223,6 +316,17 @@ Entity _entity_resolve_saved_id(unsigned int id)
     {
         ent = _generate_id();
         entitymap_set(load_map, sav, ent.id);
+        entitymap_set(load_saved_map, sav, sav.id);
+    }
+    else if ((unsigned int) entitymap_get(load_saved_map, sav) != sav.id)
+    {
+        /*
+         * an older generation of an index we've already mapped -- live
+         * entities are loaded first so this one is stale, keep it so
+         */
+        ent = _make(entity_index(ent), (entity_generation(ent)
+                                        + ENTITY_GENERATION_MASK)
+                    & ENTITY_GENERATION_MASK);
     }
     return ent;
 }
@@ -245,9 +349,11 @@ bool entity_load(Entity *ent, const char *n, Entity d, Store *s)
 void entity_load_all_begin()
 {
     load_map = entitymap_new(entity_nil.id);
+    load_saved_map = entitymap_new(entity_nil.id);
 }
 void entity_load_all_end()
 {
+    entitymap_free(load_saved_map);
     entitymap_free(load_map);
     entity_clear_save_filters();
 }
@@ -258,11 +364,25 @@ bool entity_eq(Entity e, Entity f)
     return e.id == f.id;
 }
 
+/* save destroyed entities in list with given pass number */
+static void _destroyed_save(Array *list, unsigned int pass, Store *s)
+{
+    Entity *ent;
+    Store *entry_s;
+
+    array_foreach(ent, list)
+        if (entity_get_save_filter(*ent))
+            if (store_child_save(&entry_s, NULL, s))
+            {
+                entity_save(ent, "ent", entry_s);
+                uint_save(&pass, "pass", entry_s);
+            }
+}
+
 void entity_save_all(Store *s)
 {
-    DestroyEntry *entry;
     ExistsPoolElem *exists;
-    Store *entity_s, *exists_s, *destroyed_s, *entry_s;
+    Store *entity_s, *exists_s, *destroyed_s;
 
     if (store_child_save(&entity_s, "entity", s))
     {
@@ -270,20 +390,18 @@ void entity_save_all(Store *s)
                                 "exists_pool", entity_s);
 
         if (store_child_save(&destroyed_s, "destroyed", entity_s))
-            array_foreach(entry, destroyed)
-                if (entity_get_save_filter(entry->ent))
-                    if (store_child_save(&entry_s, NULL, destroyed_s))
-                    {
-                        entity_save(&entry->ent, "ent", entry_s);
-                        uint_save(&entry->pass, "pass", entry_s);
-                    }
+        {
+            _destroyed_save(destroyed, 0, destroyed_s);
+            _destroyed_save(releasing, 1, destroyed_s);
+        }
     }
 }
 
 void entity_load_all(Store *s)
 {
-    DestroyEntry *entry;
     ExistsPoolElem *exists;
+    Entity ent;
+    unsigned int pass;
     Store *entity_s, *exists_s, *destroyed_s, *entry_s;
 
     if (store_child_load(&entity_s, "entity", s))
@@ -294,10 +412,10 @@ void entity_load_all(Store *s)
         if (store_child_load(&destroyed_s, "destroyed", entity_s))
             while (store_child_load(&entry_s, NULL, destroyed_s))
             {
-                entry = array_add(destroyed);
-                error_assert(entity_load(&entry->ent, "ent", entity_nil,
-                                         entry_s));
-                uint_load(&entry->pass, "pass", 0, entry_s);
+                error_assert(entity_load(&ent, "ent", entity_nil, entry_s));
+                uint_load(&pass, "pass", 0, entry_s);
+                if (!entity_destroyed(ent))
+                    _destroy(ent, pass == 0 ? destroyed : releasing);
             }
     }
 }
@@ -8,6 +8,12 @@
 
 SCRIPT(entity,
 
+       /*
+        * id packs an index (low ENTITY_INDEX_BITS bits) and a generation
+        * (remaining bits) -- the generation is bumped on destroy so old
+        * copies of an Entity never compare equal to a later one that
+        * reuses its index
+        */
        typedef struct Entity Entity;
        struct Entity { unsigned int id; };
        EXPORT extern Entity entity_nil; /* no valid Entity has this value */
@@ -15,8 +21,25 @@ SCRIPT(entity,
        EXPORT Entity entity_create(); /* claim an unused Entity id */
        EXPORT void entity_destroy(Entity ent); /* release an Entity id */
        EXPORT void entity_destroy_all();
+
+       /* create/destroy n entities at once, ents is an array of n */
+       EXPORT void entity_create_n(unsigned int n, Entity *ents);
+       EXPORT void entity_destroy_n(unsigned int n, const Entity *ents);
+       /*
+        * true for any destroyed (stale) Entity -- until its slot is reused
+        * so often that the 12-bit generation wraps around, after which it
+        * may look live again
+        */
        EXPORT bool entity_destroyed(Entity ent);
 
+       /*
+        * entities destroyed in this and the previous update -- each
+        * destroyed Entity is listed for at least one whole update of
+        * every system, so removing these each update is enough
+        */
+       EXPORT unsigned int entity_get_num_destroyed();
+       EXPORT Entity entity_get_nth_destroyed(unsigned int n);
+
        EXPORT bool entity_eq(Entity e, Entity f);
 
        /*
@@ -52,5 +75,12 @@ void entity_load_all_end();
 
 #define entity_eq(e, f) ((e).id == (f).id)
 
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GENERATION_MASK (~0u >> ENTITY_INDEX_BITS)
+
+#define entity_index(e) ((e).id & ENTITY_INDEX_MASK)
+#define entity_generation(e) ((e).id >> ENTITY_INDEX_BITS)
+
 #endif
 
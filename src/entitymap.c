@@ -2,19 +2,33 @@
 
 #include <stdlib.h>
 
-#define MIN_CAPACITY 2
+#define PAGE_BITS 8
+#define PAGE_SIZE (1 << PAGE_BITS)        /* number of keys per page */
+#define PAGE_MASK (PAGE_SIZE - 1)
+
+#define MIN_NPAGES 2
+
+/* a run of PAGE_SIZE consecutive keys */
+typedef struct Page Page;
+struct Page
+{
+    unsigned int count;      /* number of keys with non-default values */
+    int arr[PAGE_SIZE];
+};
 
 struct EntityMap
 {
-    int *arr;
-    unsigned int bound;      /* 1 + maximum key */
-    unsigned int capacity;   /* number of elements we have heap space for */
+    Page **pages;            /* NULL for pages with no keys set */
+    unsigned int bound;      /* 1 + maximum page with keys set */
+    unsigned int npages;     /* number of page pointers we have space for */
+    unsigned int nalloced;   /* number of non-NULL pages */
     int def;                 /* value for unset keys */
 
     /*
      * invariants:
-     *    bound <= capacity (so that maximum key < capacity)
-     *    MIN_CAPACITY <= capacity
+     *    bound <= npages (so that maximum page < npages)
+     *    MIN_NPAGES <= npages
+     *    pages[i] != NULL iff. pages[i]->count > 0
      */
 };
 
@@ -23,11 +37,20 @@ static void _init(EntityMap *emap)
     unsigned int i;
 
     emap->bound = 0;
-    emap->capacity = MIN_CAPACITY;
-    emap->arr = malloc(emap->capacity * sizeof(*emap->arr));
+    emap->npages = MIN_NPAGES;
+    emap->nalloced = 0;
+    emap->pages = malloc(emap->npages * sizeof(*emap->pages));
+
+    for (i = 0; i < emap->npages; ++i)
+        emap->pages[i] = NULL;
+}
+static void _deinit(EntityMap *emap)
+{
+    unsigned int i;
 
-    for (i = 0; i < emap->capacity; ++i)
-        emap->arr[i] = emap->def;
+    for (i = 0; i < emap->bound; ++i)
+        free(emap->pages[i]);
+    free(emap->pages);
 }
 
 EntityMap *entitymap_new(int def)
@@ -41,82 +64,178 @@ EntityMap *entitymap_new(int def)
 }
 void entitymap_clear(EntityMap *emap)
 {
-    free(emap->arr);
+    _deinit(emap);
     _init(emap);
 }
 void entitymap_free(EntityMap *emap)
 {
-    free(emap->arr);
+    _deinit(emap);
     free(emap);
 }
 
 static void _grow(EntityMap *emap)
 {
-    unsigned int new_capacity, i, bound;
+    unsigned int new_npages, i, bound;
 
-    /* find next power of 2 (TODO: use log?) */
+    /* find next power of 2 */
     bound = emap->bound;
-    for (new_capacity = emap->capacity; new_capacity < bound;
-         new_capacity <<= 1);
+    for (new_npages = emap->npages; new_npages < bound; new_npages <<= 1);
 
     /* grow, clear new */
-    emap->arr = realloc(emap->arr, new_capacity * sizeof(*emap->arr));
-    for (i = emap->capacity; i < new_capacity; ++i)
-        emap->arr[i] = emap->def;
-    emap->capacity = new_capacity;
+    emap->pages = realloc(emap->pages, new_npages * sizeof(*emap->pages));
+    for (i = emap->npages; i < new_npages; ++i)
+        emap->pages[i] = NULL;
+    emap->npages = new_npages;
 }
 static void _shrink(EntityMap *emap)
 {
-    unsigned int new_capacity, bound_times_4;
+    unsigned int new_npages, bound_times_4;
 
-    if (emap->capacity <= MIN_CAPACITY)
+    if (emap->npages <= MIN_NPAGES)
         return;
 
-    /* halve capacity while bound is less than a fourth */
+    /* halve page directory while bound is less than a fourth */
     bound_times_4 = emap->bound << 2;
-    if (bound_times_4 >= emap->capacity)
+    if (bound_times_4 >= emap->npages)
         return;
-    for (new_capacity = emap->capacity;
-         new_capacity > MIN_CAPACITY && bound_times_4 < new_capacity;
-         new_capacity >>= 1);
-    if (new_capacity < MIN_CAPACITY)
-        new_capacity = MIN_CAPACITY;
-
-    emap->arr = realloc(emap->arr, new_capacity * sizeof(*emap->arr));
-    emap->capacity = new_capacity;
+    for (new_npages = emap->npages;
+         new_npages > MIN_NPAGES && bound_times_4 < new_npages;
+         new_npages >>= 1);
+    if (new_npages < MIN_NPAGES)
+        new_npages = MIN_NPAGES;
+
+    emap->pages = realloc(emap->pages, new_npages * sizeof(*emap->pages));
+    emap->npages = new_npages;
+}
+
+static Page *_page_new(EntityMap *emap)
+{
+    unsigned int i;
+    Page *page;
+
+    page = malloc(sizeof(Page));
+    page->count = 0;
+    for (i = 0; i < PAGE_SIZE; ++i)
+        page->arr[i] = emap->def;
+    ++emap->nalloced;
+    return page;
+}
+static void _page_free(EntityMap *emap, unsigned int p)
+{
+    free(emap->pages[p]);
+    emap->pages[p] = NULL;
+    --emap->nalloced;
+
+    /* possibly move bound down and shrink */
+    if (emap->bound == p + 1)
+    {
+        while (emap->bound > 0 && !emap->pages[emap->bound - 1])
+            --emap->bound;
+        _shrink(emap);
+    }
 }
 
 void entitymap_set(EntityMap *emap, Entity ent, int val)
 {
+    unsigned int index, p;
+    Page *page;
+    int *slot;
+
+    index = entity_index(ent);
+    p = index >> PAGE_BITS;
+
     if (val == emap->def) /* deleting? */
     {
-        emap->arr[ent.id] = val;
-
-        /* possibly move bound down and shrink */
-        if (emap->bound == ent.id + 1)
-        {
-            while (emap->bound > 0 && emap->arr[emap->bound - 1] == emap->def)
-                --emap->bound;
-            _shrink(emap);
-        }
+        if (p >= emap->bound || !(page = emap->pages[p]))
+            return; /* already unset */
+        slot = &page->arr[index & PAGE_MASK];
+        if (*slot == emap->def)
+            return;
+        *slot = val;
+
+        /* free page if it has no more keys */
+        if (--page->count == 0)
+            _page_free(emap, p);
     }
     else
     {
         /* possibly move bound up and grow */
-        if (ent.id + 1 > emap->bound)
+        if (p + 1 > emap->bound)
         {
-            emap->bound = ent.id + 1;
-            if (ent.id >= emap->capacity)
+            emap->bound = p + 1;
+            if (p >= emap->npages)
                 _grow(emap);
         }
 
-        emap->arr[ent.id] = val;
+        if (!(page = emap->pages[p]))
+            page = emap->pages[p] = _page_new(emap);
+        slot = &page->arr[index & PAGE_MASK];
+        if (*slot == emap->def)
+            ++page->count;
+        *slot = val;
     }
 }
 int entitymap_get(EntityMap *emap, Entity ent)
 {
-    if (ent.id >= emap->capacity)
+    unsigned int index, p;
+    Page *page;
+
+    index = entity_index(ent);
+    p = index >> PAGE_BITS;
+    if (p >= emap->bound || !(page = emap->pages[p]))
         return emap->def;
-    return emap->arr[ent.id];
+    return page->arr[index & PAGE_MASK];
+}
+
+size_t entitymap_get_memory_usage(EntityMap *emap)
+{
+    return sizeof(EntityMap)
+        + emap->npages * sizeof(*emap->pages)
+        + emap->nalloced * sizeof(Page);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef ENTITYMAP_TEST
+
+#include <stdio.h>
+
+void dump(EntityMap *emap)
+{
+    printf("{ (%u, %u, %u) %lu bytes }\n", emap->bound, emap->npages,
+           emap->nalloced, (unsigned long) entitymap_get_memory_usage(emap));
+}
+
+int main()
+{
+    unsigned int i;
+    Entity ent;
+    EntityMap *emap = entitymap_new(-1);
+
+    /* a few sparse keys only allocate their own pages */
+    for (i = 0; i < 5; ++i)
+    {
+        ent.id = i * 100000;
+        entitymap_set(emap, ent, i);
+        dump(emap);
+    }
+    for (i = 0; i < 5; ++i)
+    {
+        ent.id = i * 100000;
+        printf("%u -> %d\n", ent.id, entitymap_get(emap, ent));
+    }
+
+    /* unset them from the top, pages and directory should go away */
+    for (i = 5; i-- > 0; )
+    {
+        ent.id = i * 100000;
+        entitymap_set(emap, ent, -1);
+        dump(emap);
+    }
+
+    entitymap_free(emap);
+
+    return 0;
 }
 
+#endif
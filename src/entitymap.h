@@ -1,10 +1,18 @@
 #ifndef ENTITYMAP_H
 #define ENTITYMAP_H
 
+#include <stddef.h>
+
 #include "entity.h"
 
 /*
  * map of Entity -> int
+ *
+ * keyed by entity_index(ent), so all generations of an index share an
+ * entry -- clear entries of destroyed entities before their index is reused
+ *
+ * keys are stored in fixed-size pages that are only allocated while they
+ * contain set keys, so a map holding a few large keys stays small
  */
 
 typedef struct EntityMap EntityMap;
@@ -16,5 +24,7 @@ void entitymap_free(EntityMap *emap);
 void entitymap_set(EntityMap *emap, Entity ent, int val);
 int entitymap_get(EntityMap *emap, Entity ent);
 
+size_t entitymap_get_memory_usage(EntityMap *emap); /* in bytes */
+
 #endif
 
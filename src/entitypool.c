@@ -1,16 +1,24 @@
 #include "entitypool.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "entitymap.h"
 #include "array.h"
 #include "error.h"
 
+/* insertion sort moves at most this many elements per pool element */
+#define MAX_INSERTION_MOVES 8
+
 struct EntityPool
 {
     /* just a map of indices into an array, -1 if doesn't exist */
     EntityMap *emap;
     Array *array;
+    size_t object_size;
+
+    /* comparator array is sorted by, NULL if unsorted */
+    int (*sorted_by)(const void *, const void *);
 };
 
 EntityPool *entitypool_new_(size_t object_size)
@@ -19,6 +27,8 @@ EntityPool *entitypool_new_(size_t object_size)
 
     pool->emap = entitymap_new(-1);
     pool->array = array_new_(object_size);
+    pool->object_size = object_size;
+    pool->sorted_by = NULL;
 
     return pool;
 }
@@ -31,12 +41,22 @@ void entitypool_free(EntityPool *pool)
 
 void *entitypool_add(EntityPool *pool, Entity ent)
 {
+    int i;
     EntityPoolElem *elem;
 
     if ((elem = entitypool_get(pool, ent)))
         return elem;
 
+    /* stale element from an older generation of this index? drop it */
+    i = entitymap_get(pool->emap, ent);
+    if (i >= 0)
+    {
+        elem = array_get(pool->array, i);
+        entitypool_remove(pool, elem->ent);
+    }
+
     /* add element to array and set id in map */
+    pool->sorted_by = NULL;
     elem = array_add(pool->array);
     elem->ent = ent;
     entitymap_set(pool->emap, ent, array_length(pool->array) - 1);
@@ -50,9 +70,15 @@ void entitypool_remove(EntityPool *pool, Entity ent)
     i = entitymap_get(pool->emap, ent);
     if (i >= 0)
     {
+        /* ignore if mapped element is of another generation */
+        elem = array_get(pool->array, i);
+        if (!entity_eq(elem->ent, ent))
+            return;
+
         /* remove may swap with last element, so fix that mapping */
         if (array_quick_remove(pool->array, i))
         {
+            pool->sorted_by = NULL;
             elem = array_get(pool->array, i);
             entitymap_set(pool->emap, elem->ent, i);
         }
@@ -64,10 +90,16 @@ void entitypool_remove(EntityPool *pool, Entity ent)
 void *entitypool_get(EntityPool *pool, Entity ent)
 {
     int i;
+    EntityPoolElem *elem;
 
     i = entitymap_get(pool->emap, ent);
     if (i >= 0)
-        return array_get(pool->array, i);
+    {
+        /* index may be mapped for another generation */
+        elem = array_get(pool->array, i);
+        if (entity_eq(elem->ent, ent))
+            return elem;
+    }
     return NULL;
 }
 
@@ -89,28 +121,155 @@ unsigned int entitypool_size(EntityPool *pool)
     return array_length(pool->array);
 }
 
+size_t entitypool_get_map_memory_usage(EntityPool *pool)
+{
+    return entitymap_get_memory_usage(pool->emap);
+}
+
 void entitypool_clear(EntityPool *pool)
 {
     entitymap_clear(pool->emap);
     array_clear(pool->array);
+    pool->sorted_by = NULL;
+}
+
+/*
+ * insertion sort, good when only a few elements are out of place -- sets
+ * *lo to lowest index that moved, returns false if gave up because too
+ * much was moving
+ */
+static bool _insertion_sort(EntityPool *pool,
+                            int (*compar)(const void *, const void *),
+                            unsigned int *lo)
+{
+    unsigned int i, j, n, moves, max_moves;
+    size_t size;
+    char *buf, *tmp;
+
+    n = array_length(pool->array);
+    buf = array_begin(pool->array);
+    size = pool->object_size;
+    tmp = malloc(size);
+
+    *lo = n;
+    moves = 0;
+    max_moves = MAX_INSERTION_MOVES * n;
+    for (i = 1; i < n; ++i)
+    {
+        if (compar(buf + (i - 1) * size, buf + i * size) <= 0)
+            continue;
+
+        /* find place for element i, shift others up */
+        memcpy(tmp, buf + i * size, size);
+        for (j = i - 1; j > 0 && compar(buf + (j - 1) * size, tmp) > 0; --j);
+        memmove(buf + (j + 1) * size, buf + j * size, (i - j) * size);
+        memcpy(buf + j * size, tmp, size);
+
+        if (j < *lo)
+            *lo = j;
+        if ((moves += i - j) > max_moves)
+        {
+            free(tmp);
+            return false;
+        }
+    }
+
+    free(tmp);
+    return true;
 }
 
 void entitypool_sort(EntityPool *pool,
                      int (*compar)(const void *, const void *))
 {
-    unsigned int i, n;
+    unsigned int i, n, lo;
     EntityPoolElem *elem;
 
-    array_sort(pool->array, compar);
+    if (pool->sorted_by == compar)
+        return;
 
-    /* remap Entity -> index */
+    /* try insertion sort first, fall back to qsort if too much is out */
     n = array_length(pool->array);
-    for (i = 0; i < n; ++i)
+    if (!_insertion_sort(pool, compar, &lo))
+    {
+        array_sort(pool->array, compar);
+        lo = 0;
+    }
+    pool->sorted_by = compar;
+
+    /* remap Entity -> index for those that moved */
+    for (i = lo; i < n; ++i)
     {
         elem = array_get(pool->array, i);
         entitymap_set(pool->emap, elem->ent, i);
     }
 }
+void entitypool_mark_unsorted(EntityPool *pool)
+{
+    pool->sorted_by = NULL;
+}
+
+void entitypool_join_begin(EntityPoolJoin *join, EntityPool **pools,
+                           unsigned int npools)
+{
+    unsigned int i;
+
+    error_assert(npools > 0 && npools <= 8, "must join 1 to 8 pools");
+
+    /* drive with smallest pool */
+    join->npools = npools;
+    join->driver = 0;
+    for (i = 0; i < npools; ++i)
+    {
+        join->pools[i] = pools[i];
+        join->begins[i] = array_begin(pools[i]->array);
+        join->lengths[i] = array_length(pools[i]->array);
+        join->sizes[i] = pools[i]->object_size;
+        if (join->lengths[i] < join->lengths[join->driver])
+            join->driver = i;
+    }
+    join->pos = 0;
+    join->ent = entity_nil;
+}
+bool entitypool_join_next(EntityPoolJoin *join)
+{
+    unsigned int i, pos, d = join->driver;
+    EntityPoolElem *elem;
+    Entity ent;
+
+    while ((pos = join->pos++) < join->lengths[d])
+    {
+        elem = (EntityPoolElem *) (join->begins[d] + pos * join->sizes[d]);
+        ent = elem->ent;
+        join->elems[d] = elem;
+
+        for (i = 0; i < join->npools; ++i)
+        {
+            if (i == d)
+                continue;
+
+            /* same position? skip the map lookup */
+            elem = NULL;
+            if (pos < join->lengths[i])
+                elem = (EntityPoolElem *) (join->begins[i]
+                                           + pos * join->sizes[i]);
+            if (!elem || !entity_eq(elem->ent, ent))
+                elem = entitypool_get(join->pools[i], ent);
+
+            if (!elem)
+                break;
+            join->elems[i] = elem;
+        }
+
+        if (i == join->npools)
+        {
+            join->ent = ent;
+            return true; /* in all pools */
+        }
+    }
+
+    join->ent = entity_nil;
+    return false;
+}
 
 void entitypool_elem_save(EntityPool *pool, void *elem, Store *s)
 {
@@ -5,12 +5,56 @@
 
 #include "entity.h"
 #include "saveload.h"
+#include "script_export.h"
 
 /*
- * continuous in memory, may be relocated/shuffled so be careful
+ * continuous in memory, may be relocated/shuffled so be careful -- see
+ * chunkpool.h for a pool whose elements stay in place
  */
 
-typedef struct EntityPool EntityPool;
+SCRIPT(entitypool,
+
+       typedef struct EntityPool EntityPool;
+
+       /*
+        * iterates over entities that are in all of a set of pools, walking
+        * the smallest pool and looking up the rest -- can be used as:
+        *
+        *     EntityPool *pools[] = { pool, transform_get_pool() };
+        *     EntityPoolJoin join;
+        *
+        *     entitypool_join_begin(&join, pools, 2);
+        *     while (entitypool_join_next(&join))
+        *         ... use join.ent, join.elems[0], join.elems[1] ...
+        *
+        * elems[i] is the element in pools[i] -- when a pool has the
+        * Entity at the same position as the smallest pool it is read
+        * sequentially, so keeping pools in the same order is fastest
+        *
+        * at most 8 pools, don't add/remove in pools while iterating
+        */
+       typedef struct EntityPoolJoin EntityPoolJoin;
+       struct EntityPoolJoin
+       {
+           Entity ent;           /* Entity of current match */
+           void *elems[8];       /* current match's elements, per pool */
+
+           EntityPool *pools[8];
+           char *begins[8];      /* pools' arrays, cached at begin */
+           unsigned int lengths[8];
+           size_t sizes[8];
+           unsigned int npools;
+           unsigned int driver;  /* index of smallest pool */
+           unsigned int pos;     /* next position in smallest pool */
+       };
+
+       EXPORT void entitypool_join_begin(EntityPoolJoin *join,
+                                         EntityPool **pools,
+                                         unsigned int npools);
+       /* false at end */
+       EXPORT bool entitypool_join_next(EntityPoolJoin *join);
+
+    )
 
 /*
  * this struct must be at the top of pool elements:
@@ -55,33 +99,45 @@ void *entitypool_nth(EntityPool *pool, unsigned int n); /* 0-indexed */
 
 unsigned int entitypool_size(EntityPool *pool);
 
+/* bytes used by the Entity -> element index map */
+size_t entitypool_get_map_memory_usage(EntityPool *pool);
+
 void entitypool_clear(EntityPool *pool);
 
-/* compare is a comparator function like for qsort(3) */
+/*
+ * compare is a comparator function like for qsort(3) -- does nothing if
+ * already sorted with the same compar and order hasn't changed since, so
+ * can call every frame
+ *
+ * add/remove invalidate order automatically, but if you change what compar
+ * looks at in an element call entitypool_mark_unsorted(...)
+ */
 void entitypool_sort(EntityPool *pool,
                      int (*compar)(const void *, const void *));
+void entitypool_mark_unsorted(EntityPool *pool);
 
 /* elem must be /pointer to/ pointer to element */
 void entitypool_elem_save(EntityPool *pool, void *elem, Store *s);
 void entitypool_elem_load(EntityPool *pool, void *elem, Store *s);
 
 /*
- * call 'func' on each destroyed Entity, generally done in
+ * call 'func' on each destroyed Entity in the pool, generally done in
  * *_update_all() -- check transform.c, sprite.c, etc. for examples
+ *
+ * only looks at entity_get_nth_destroyed(...), so cost is proportional to
+ * number of recently destroyed entities rather than to pool size
  */
-#define entitypool_remove_destroyed(pool, func)         \
-    do                                                  \
-    {                                                   \
-        unsigned int __i;                               \
-        EntityPoolElem *__e;                            \
-        for (__i = 0; __i < entitypool_size(pool); )    \
-        {                                               \
-            __e = entitypool_nth(pool, __i);            \
-            if (entity_destroyed(__e->ent))             \
-                func(__e->ent);                         \
-            else                                        \
-                ++__i;                                  \
-        }                                               \
+#define entitypool_remove_destroyed(pool, func)                 \
+    do                                                          \
+    {                                                           \
+        unsigned int __i;                                       \
+        Entity __ent;                                           \
+        for (__i = 0; __i < entity_get_num_destroyed(); ++__i)  \
+        {                                                       \
+            __ent = entity_get_nth_destroyed(__i);              \
+            if (entitypool_get(pool, __ent))                    \
+                func(__ent);                                    \
+        }                                                       \
     } while (0)
 
 /*
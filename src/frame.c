@@ -0,0 +1,89 @@
+#include "frame.h"
+
+#include <stdlib.h>
+
+#define ALIGN 16
+#define MIN_BLOCK_SIZE (64 * 1024)
+
+/* memory is taken from a stack of blocks, only the top one has space */
+typedef struct Block Block;
+struct Block
+{
+    Block *prev;
+    size_t size;             /* size of data */
+    size_t used;             /* bytes of data handed out */
+};
+
+/* data starts after header, at an ALIGN boundary */
+#define HEADER_SIZE ((sizeof(Block) + ALIGN - 1) & ~((size_t) ALIGN - 1))
+
+static Block *top = NULL;
+
+static void _block_new(size_t size)
+{
+    Block *block;
+
+    block = malloc(HEADER_SIZE + size);
+    block->prev = top;
+    block->size = size;
+    block->used = 0;
+    top = block;
+}
+
+static void _free_all()
+{
+    Block *prev;
+
+    for (; top; top = prev)
+    {
+        prev = top->prev;
+        free(top);
+    }
+}
+
+void *frame_alloc(size_t size)
+{
+    size_t block_size;
+    char *p;
+
+    size = (size + ALIGN - 1) & ~((size_t) ALIGN - 1);
+
+    /* not enough space? start a new block, double the last one */
+    if (!top || top->used + size > top->size)
+    {
+        block_size = top ? top->size << 1 : MIN_BLOCK_SIZE;
+        while (block_size < size)
+            block_size <<= 1;
+        _block_new(block_size);
+    }
+
+    p = (char *) top + HEADER_SIZE + top->used;
+    top->used += size;
+    return p;
+}
+
+void frame_deinit()
+{
+    _free_all();
+}
+
+void frame_update_all()
+{
+    size_t size;
+    Block *block;
+
+    if (!top)
+        return;
+
+    /* needed more than one block? replace with one that fits all */
+    if (top->prev)
+    {
+        size = 0;
+        for (block = top; block; block = block->prev)
+            size += block->size;
+        _free_all();
+        _block_new(size);
+    }
+
+    top->used = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+
+#include "script_export.h"
+
+/*
+ * per-frame scratch memory -- memory from frame_alloc(...) stays valid till
+ * the end of the next system_update_all(), then it's all released at once,
+ * so never free(...) it and don't hold on to it across frames
+ *
+ * meant for temporary buffers that would otherwise be malloc(...)'d and
+ * free(...)'d within a frame
+ */
+
+SCRIPT(frame,
+
+       /* aligned to 16 bytes */
+       EXPORT void *frame_alloc(size_t size);
+
+    )
+
+void frame_deinit();
+void frame_update_all(); /* releases everything, at end of update */
+
+#endif
+
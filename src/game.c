@@ -9,6 +9,7 @@
 #include "glew_glfw.h"
 #include "system.h"
 #include "console.h"
+#include "headless.h"
 
 #ifdef CGAME_DEBUG_WINDOW
 #include "debugwin.h"
@@ -22,6 +23,8 @@ static bool quit = false; /* exit main loop if true */
 static int sargc = 0;
 static char **sargv;
 
+static Vec2 headless_window_size = { 800, 600 };
+
 /* ------------------------------------------------------------------------- */
 
 static void _glfw_error_callback(int error, const char *desc)
@@ -29,7 +32,7 @@ static void _glfw_error_callback(int error, const char *desc)
     fprintf(stderr, "glfw: %s\n", desc);
 }
 
-static void _game_init()
+static void _game_init_window()
 {
     /* initialize glfw */
     glfwSetErrorCallback(_glfw_error_callback);
@@ -52,6 +55,14 @@ static void _game_init()
     glewExperimental = GL_TRUE;
     glewInit();
     glGetError(); /* see http://www.opengl.org/wiki/OpenGL_Loading_Library */
+}
+
+static void _game_init(bool headless)
+{
+    if (headless)
+        headless_init(); /* no window, GL calls just get counted */
+    else
+        _game_init_window();
 
     /* some GL settings */
     glEnable(GL_PROGRAM_POINT_SIZE);
@@ -76,12 +87,18 @@ static void _game_deinit()
     /* deinit systems */
     system_deinit();
 
-    /* deinit glfw */
-    glfwTerminate();
+    /* deinit glfw or headless */
+    if (headless_get_enabled())
+        headless_deinit();
+    else
+        glfwTerminate();
 }
 
 static void _game_events()
 {
+    if (headless_get_enabled())
+        return; /* run till script calls game_quit() */
+
     glfwPollEvents();
 
     if (glfwWindowShouldClose(game_window))
@@ -106,17 +123,38 @@ static void _game_draw()
 
     glClear(GL_COLOR_BUFFER_BIT);
     system_draw_all();
-    glfwSwapBuffers(game_window);
+    if (headless_get_enabled())
+        headless_swap_buffers();
+    else
+        glfwSwapBuffers(game_window);
 }
 
 /* ------------------------------------------------------------------------- */
 
+/*
+ * strip '--headless' out of args if present so that scripts see the
+ * same args either way, returns whether it was present
+ */
+static bool _strip_headless_arg()
+{
+    int i, j;
+    bool found = false;
+
+    for (i = j = 0; i < sargc; ++i)
+        if (!strcmp(sargv[i], "--headless"))
+            found = true;
+        else
+            sargv[j++] = sargv[i];
+    sargc = j;
+    return found;
+}
+
 void game_run(int argc, char **argv)
 {
     sargc = argc;
     sargv = argv;
 
-    _game_init();
+    _game_init(_strip_headless_arg());
 
     while (!quit)
     {
@@ -135,11 +173,17 @@ void game_set_bg_color(Color c)
 
 void game_set_window_size(Vec2 s)
 {
-    glfwSetWindowSize(game_window, s.x, s.y);
+    if (headless_get_enabled())
+        headless_window_size = s;
+    else
+        glfwSetWindowSize(game_window, s.x, s.y);
 }
 Vec2 game_get_window_size()
 {
     int w, h;
+
+    if (headless_get_enabled())
+        return headless_window_size;
     glfwGetWindowSize(game_window, &w, &h);
     return vec2(w, h);
 }
@@ -1,7 +1,7 @@
 #ifndef GFX_H
 #define GFX_H
 
-#include <GL/glew.h>
+#include "glew_glfw.h"
 
 /*
  * compile, link program given paths to shader files, possibly NULL,
@@ -5,5 +5,43 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+/*
+ * GL 1.1 functions are linked directly rather than loaded into GLEW's
+ * function pointers, so we call them through pointers of our own --
+ * lets headless mode swap them out along with GLEW's (see headless.h)
+ */
+#ifndef GL11_NO_REDIRECT
+
+extern void (GLAPIENTRY *gl11_BindTexture)(GLenum, GLuint);
+extern void (GLAPIENTRY *gl11_BlendFunc)(GLenum, GLenum);
+extern void (GLAPIENTRY *gl11_Clear)(GLbitfield);
+extern void (GLAPIENTRY *gl11_ClearColor)(GLclampf, GLclampf, GLclampf,
+                                          GLclampf);
+extern void (GLAPIENTRY *gl11_DeleteTextures)(GLsizei, const GLuint *);
+extern void (GLAPIENTRY *gl11_Disable)(GLenum);
+extern void (GLAPIENTRY *gl11_DrawArrays)(GLenum, GLint, GLsizei);
+extern void (GLAPIENTRY *gl11_Enable)(GLenum);
+extern void (GLAPIENTRY *gl11_GenTextures)(GLsizei, GLuint *);
+extern GLenum (GLAPIENTRY *gl11_GetError)(void);
+extern void (GLAPIENTRY *gl11_TexImage2D)(GLenum, GLint, GLint, GLsizei,
+                                          GLsizei, GLint, GLenum, GLenum,
+                                          const GLvoid *);
+extern void (GLAPIENTRY *gl11_TexParameteri)(GLenum, GLenum, GLint);
+
+#define glBindTexture gl11_BindTexture
+#define glBlendFunc gl11_BlendFunc
+#define glClear gl11_Clear
+#define glClearColor gl11_ClearColor
+#define glDeleteTextures gl11_DeleteTextures
+#define glDisable gl11_Disable
+#define glDrawArrays gl11_DrawArrays
+#define glEnable gl11_Enable
+#define glGenTextures gl11_GenTextures
+#define glGetError gl11_GetError
+#define glTexImage2D gl11_TexImage2D
+#define glTexParameteri gl11_TexParameteri
+
+#endif
+
 #endif
 
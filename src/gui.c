@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <GL/glew.h>
+#include "glew_glfw.h"
 
 #include "error.h"
 #include "entitypool.h"
@@ -18,6 +18,7 @@
 #include "edit.h"
 #include "entitymap.h"
 #include "timing.h"
+#include "frame.h"
 
 static Entity gui_root; /* all gui should be descendants of this to move
                            with screen */
@@ -422,7 +423,6 @@ static void _common_mouse_event(EntityMap *emap, MouseCode mouse,
 {
     Gui *gui;
     Vec2 m;
-    Mat3 t;
     Entity ent;
     bool some_focused = false;
 
@@ -433,8 +433,7 @@ static void _common_mouse_event(EntityMap *emap, MouseCode mouse,
         {
             ent = gui->pool_elem.ent;
 
-            t = mat3_inverse(transform_get_world_matrix(ent));
-            if (bbox_contains(gui->bbox, mat3_transform(t, m)))
+            if (bbox_contains(gui->bbox, transform_world_to_local(ent, m)))
             {
                 entitymap_set(emap, ent, mouse);
 
@@ -575,6 +574,7 @@ void gui_rect_add(Entity ent)
     rect->vfit = true;
     rect->hfill = false;
     rect->vfill = false;
+    rect->depth = 0;
 }
 void gui_rect_remove(Entity ent)
 {
@@ -818,16 +818,24 @@ static void _rect_update_fill(Rect *rect)
 static void _rect_update_depth(Rect *rect)
 {
     Rect *prect;
+    int depth;
 
     prect = entitypool_get(rect_pool,
                            transform_get_parent(rect->pool_elem.ent));
     if (prect)
     {
         _rect_update_parent_first(prect->pool_elem.ent);
-        rect->depth = prect->depth + 1;
+        depth = prect->depth + 1;
     }
     else
-        rect->depth = 0;
+        depth = 0;
+
+    /* need to re-sort if changed */
+    if (rect->depth != depth)
+    {
+        rect->depth = depth;
+        entitypool_mark_unsorted(rect_pool);
+    }
 }
 
 static void _rect_update_parent_first(Entity ent)
@@ -890,15 +898,18 @@ static int _rect_depth_compare(const void *a, const void *b)
 {
     const Rect *ra = a, *rb = b;
     if (ra->depth == rb->depth)
-        return ((int) ra->pool_elem.ent.id) - ((int) rb->pool_elem.ent.id);
+        return ((int) entity_index(ra->pool_elem.ent))
+            - ((int) entity_index(rb->pool_elem.ent));
     return ra->depth - rb->depth;
 }
 
 static void _rect_draw_all()
 {
-    unsigned int nrects;
+    Rect *rect, *rects;
+    BBox b;
+    unsigned int nrects = 0;
 
-    /* depth sort */
+    /* depth sort -- only does work if order changed */
     entitypool_sort(rect_pool, _rect_depth_compare);
 
     /* bind shader program */
@@ -908,12 +919,22 @@ static void _rect_draw_all()
                        1, GL_FALSE,
                        (const GLfloat *) camera_get_inverse_view_matrix_ptr());
 
+    /* pack visible ones in view */
+    rects = frame_alloc(entitypool_size(rect_pool) * sizeof(Rect));
+    entitypool_foreach(rect, rect_pool)
+    {
+        if (!rect->visible)
+            continue;
+        b = bbox_bound(vec2(0, -rect->size.y), vec2(rect->size.x, 0));
+        if (camera_in_view(bbox_transform(rect->wmat, b)))
+            rects[nrects++] = *rect;
+    }
+
     /* draw! */
     glBindVertexArray(rect_vao);
     glBindBuffer(GL_ARRAY_BUFFER, rect_vbo);
-    nrects = entitypool_size(rect_pool);
-    glBufferData(GL_ARRAY_BUFFER, nrects * sizeof(Rect),
-                 entitypool_begin(rect_pool), GL_STREAM_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, nrects * sizeof(Rect), rects,
+                 GL_STREAM_DRAW);
     glDrawArrays(GL_POINTS, 0, nrects);
 }
 
@@ -1208,10 +1229,13 @@ static void _text_draw_all()
         error_assert(gui);
         if (!gui->visible)
             continue;
-        glUniform4fv(glGetUniformLocation(text_program, "base_color"), 1,
-                     (const GLfloat *) &gui->color);
 
         wmat = transform_get_world_matrix(text->pool_elem.ent);
+        if (!camera_in_view(bbox_transform(wmat, gui->bbox)))
+            continue;
+
+        glUniform4fv(glGetUniformLocation(text_program, "base_color"), 1,
+                     (const GLfloat *) &gui->color);
         glUniformMatrix3fv(glGetUniformLocation(text_program, "wmat"),
                            1, GL_FALSE, (const GLfloat *) &wmat);
 
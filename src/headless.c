@@ -0,0 +1,291 @@
+#ifdef CGAME_WINDOWS
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 199309L /* for clock_gettime(...) */
+#include <time.h>
+#endif
+
+#define GL11_NO_REDIRECT /* we need the real GL 1.1 functions here */
+
+#include "headless.h"
+
+#include <stdio.h>
+
+#include "glew_glfw.h"
+
+typedef struct Stats Stats;
+struct Stats
+{
+    unsigned int draw_calls;
+    unsigned int bytes_uploaded;
+    unsigned int state_changes;
+};
+
+static bool enabled = false;
+static Stats curr = { 0 }, last = { 0 };
+
+/* totals over the whole run */
+static unsigned long long total_draw_calls = 0;
+static unsigned long long total_bytes_uploaded = 0;
+static unsigned long long total_state_changes = 0;
+static unsigned long long nframes = 0;
+
+static GLuint next_name = 1; /* all objects share one name space, fine */
+
+/* ------------------------------------------------------------------------- */
+
+/* GL 1.1 function pointers declared in glew_glfw.h, real ones by default */
+
+void (GLAPIENTRY *gl11_BindTexture)(GLenum, GLuint) = glBindTexture;
+void (GLAPIENTRY *gl11_BlendFunc)(GLenum, GLenum) = glBlendFunc;
+void (GLAPIENTRY *gl11_Clear)(GLbitfield) = glClear;
+void (GLAPIENTRY *gl11_ClearColor)(GLclampf, GLclampf, GLclampf,
+                                   GLclampf) = glClearColor;
+void (GLAPIENTRY *gl11_DeleteTextures)(GLsizei,
+                                       const GLuint *) = glDeleteTextures;
+void (GLAPIENTRY *gl11_Disable)(GLenum) = glDisable;
+void (GLAPIENTRY *gl11_DrawArrays)(GLenum, GLint, GLsizei) = glDrawArrays;
+void (GLAPIENTRY *gl11_Enable)(GLenum) = glEnable;
+void (GLAPIENTRY *gl11_GenTextures)(GLsizei, GLuint *) = glGenTextures;
+GLenum (GLAPIENTRY *gl11_GetError)(void) = glGetError;
+void (GLAPIENTRY *gl11_TexImage2D)(GLenum, GLint, GLint, GLsizei,
+                                   GLsizei, GLint, GLenum, GLenum,
+                                   const GLvoid *) = glTexImage2D;
+void (GLAPIENTRY *gl11_TexParameteri)(GLenum, GLenum, GLint) = glTexParameteri;
+
+/* ------------------------------------------------------------------------- */
+
+/* recording backend -- does nothing but count */
+
+#define state_stub(name, params)                                        \
+    static void GLAPIENTRY _##name params { ++curr.state_changes; }
+
+state_stub(ActiveTexture, (GLenum texture))
+state_stub(BindBuffer, (GLenum target, GLuint buffer))
+state_stub(BindTexture, (GLenum target, GLuint texture))
+state_stub(BindVertexArray, (GLuint array))
+state_stub(BlendFunc, (GLenum sfactor, GLenum dfactor))
+state_stub(ClearColor, (GLclampf r, GLclampf g, GLclampf b, GLclampf a))
+state_stub(Disable, (GLenum cap))
+state_stub(Enable, (GLenum cap))
+state_stub(EnableVertexAttribArray, (GLuint index))
+state_stub(TexParameteri, (GLenum target, GLenum pname, GLint param))
+state_stub(Uniform1f, (GLint location, GLfloat v0))
+state_stub(Uniform1i, (GLint location, GLint v0))
+state_stub(Uniform2f, (GLint location, GLfloat v0, GLfloat v1))
+state_stub(Uniform2fv, (GLint location, GLsizei count, const GLfloat *v))
+state_stub(Uniform4fv, (GLint location, GLsizei count, const GLfloat *v))
+state_stub(UniformMatrix3fv, (GLint location, GLsizei count,
+                              GLboolean transpose, const GLfloat *v))
+state_stub(UseProgram, (GLuint program))
+state_stub(VertexAttribPointer, (GLuint index, GLint size, GLenum type,
+                                 GLboolean normalized, GLsizei stride,
+                                 const GLvoid *pointer))
+
+static void GLAPIENTRY _DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    ++curr.draw_calls;
+}
+
+static void GLAPIENTRY _BufferData(GLenum target, GLsizeiptr size,
+                                   const GLvoid *data, GLenum usage)
+{
+    if (data)
+        curr.bytes_uploaded += size;
+}
+static void GLAPIENTRY _BufferSubData(GLenum target, GLintptr offset,
+                                      GLsizeiptr size, const GLvoid *data)
+{
+    if (data)
+        curr.bytes_uploaded += size;
+}
+static void GLAPIENTRY _TexImage2D(GLenum target, GLint level,
+                                   GLint internal_format,
+                                   GLsizei width, GLsizei height,
+                                   GLint border, GLenum format, GLenum type,
+                                   const GLvoid *pixels)
+{
+    unsigned int bpp;
+
+    if (!pixels)
+        return;
+    switch (format)
+    {
+        case GL_RED: case GL_ALPHA: case GL_LUMINANCE: bpp = 1; break;
+        case GL_RGB: bpp = 3; break;
+        default: bpp = 4; break;
+    }
+    curr.bytes_uploaded += width * height * bpp;
+}
+
+/* object creation hands out fresh names, deletion and the rest are no-ops */
+static void GLAPIENTRY _gen(GLsizei n, GLuint *names)
+{
+    while (n-- > 0)
+        *names++ = next_name++;
+}
+static GLuint GLAPIENTRY _CreateShader(GLenum type) { return next_name++; }
+static GLuint GLAPIENTRY _CreateProgram() { return next_name++; }
+static void GLAPIENTRY _delete(GLsizei n, const GLuint *names) {}
+static void GLAPIENTRY _object(GLuint name) {}
+static void GLAPIENTRY _AttachShader(GLuint program, GLuint shader) {}
+static void GLAPIENTRY _ShaderSource(GLuint shader, GLsizei count,
+                                     const GLchar **strings,
+                                     const GLint *lengths) {}
+static void GLAPIENTRY _Clear(GLbitfield mask) {}
+static GLenum GLAPIENTRY _GetError() { return GL_NO_ERROR; }
+
+/* queries -- shaders always compile, locations are all 0 */
+static void GLAPIENTRY _GetShaderiv(GLuint shader, GLenum pname,
+                                    GLint *param)
+{
+    *param = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+static void GLAPIENTRY _GetShaderInfoLog(GLuint shader, GLsizei size,
+                                         GLsizei *length, GLchar *log)
+{
+    if (length)
+        *length = 0;
+    if (size > 0)
+        log[0] = '\0';
+}
+static GLint GLAPIENTRY _location(GLuint program, const GLchar *name)
+{
+    return 0;
+}
+
+static void _install()
+{
+    gl11_BindTexture = _BindTexture;
+    gl11_BlendFunc = _BlendFunc;
+    gl11_Clear = _Clear;
+    gl11_ClearColor = _ClearColor;
+    gl11_DeleteTextures = _delete;
+    gl11_Disable = _Disable;
+    gl11_DrawArrays = _DrawArrays;
+    gl11_Enable = _Enable;
+    gl11_GenTextures = _gen;
+    gl11_GetError = _GetError;
+    gl11_TexImage2D = _TexImage2D;
+    gl11_TexParameteri = _TexParameteri;
+
+    __glewActiveTexture = _ActiveTexture;
+    __glewAttachShader = _AttachShader;
+    __glewBindBuffer = _BindBuffer;
+    __glewBindVertexArray = _BindVertexArray;
+    __glewBufferData = _BufferData;
+    __glewBufferSubData = _BufferSubData;
+    __glewCompileShader = _object;
+    __glewCreateProgram = _CreateProgram;
+    __glewCreateShader = _CreateShader;
+    __glewDeleteBuffers = _delete;
+    __glewDeleteProgram = _object;
+    __glewDeleteShader = _object;
+    __glewDeleteVertexArrays = _delete;
+    __glewEnableVertexAttribArray = _EnableVertexAttribArray;
+    __glewGenBuffers = _gen;
+    __glewGenVertexArrays = _gen;
+    __glewGetAttribLocation = _location;
+    __glewGetShaderInfoLog = _GetShaderInfoLog;
+    __glewGetShaderiv = _GetShaderiv;
+    __glewGetUniformLocation = _location;
+    __glewLinkProgram = _object;
+    __glewShaderSource = _ShaderSource;
+    __glewUniform1f = _Uniform1f;
+    __glewUniform1i = _Uniform1i;
+    __glewUniform2f = _Uniform2f;
+    __glewUniform2fv = _Uniform2fv;
+    __glewUniform4fv = _Uniform4fv;
+    __glewUniformMatrix3fv = _UniformMatrix3fv;
+    __glewUseProgram = _UseProgram;
+    __glewVertexAttribPointer = _VertexAttribPointer;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef CGAME_WINDOWS
+
+static LARGE_INTEGER start_time, frequency;
+
+static void _time_init()
+{
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start_time);
+}
+double headless_get_time()
+{
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return (double) (t.QuadPart - start_time.QuadPart) / frequency.QuadPart;
+}
+
+#else
+
+static struct timespec start_time;
+
+static void _time_init()
+{
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+double headless_get_time()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec - start_time.tv_sec)
+        + 1e-9 * (t.tv_nsec - start_time.tv_nsec);
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+bool headless_get_enabled()
+{
+    return enabled;
+}
+
+unsigned int headless_get_draw_calls()
+{
+    return last.draw_calls;
+}
+unsigned int headless_get_bytes_uploaded()
+{
+    return last.bytes_uploaded;
+}
+unsigned int headless_get_state_changes()
+{
+    return last.state_changes;
+}
+
+void headless_swap_buffers()
+{
+    total_draw_calls += curr.draw_calls;
+    total_bytes_uploaded += curr.bytes_uploaded;
+    total_state_changes += curr.state_changes;
+    ++nframes;
+
+    last = curr;
+    curr.draw_calls = curr.bytes_uploaded = curr.state_changes = 0;
+}
+
+void headless_init()
+{
+    enabled = true;
+    _time_init();
+    _install();
+}
+void headless_deinit()
+{
+    double secs;
+
+    if (!enabled)
+        return;
+
+    secs = headless_get_time();
+    printf("headless: %llu frames in %.3f s (%.3f ms/frame)\n",
+           nframes, secs, nframes ? 1000 * secs / nframes : 0.0);
+    printf("headless: %llu draw calls, %llu bytes uploaded, "
+           "%llu state changes\n", total_draw_calls, total_bytes_uploaded,
+           total_state_changes);
+}
+
@@ -0,0 +1,40 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+
+#include "script_export.h"
+
+/*
+ * headless mode, selected by passing '--headless' on the command line --
+ * runs the game loop with no window, GL calls go to a recording backend
+ * that just counts them so updates and draw preparation can be profiled
+ * anywhere
+ *
+ * 'state changes' are binds, enables, uniform sets and the like, 'bytes
+ * uploaded' are buffer and texture data sent with a non-NULL pointer
+ */
+
+SCRIPT(headless,
+
+       EXPORT bool headless_get_enabled();
+
+       /* all 0 if not headless */
+       EXPORT unsigned int headless_get_draw_calls(); /* in last frame */
+       EXPORT unsigned int headless_get_bytes_uploaded(); /* in last frame */
+       EXPORT unsigned int headless_get_state_changes(); /* in last frame */
+
+    )
+
+/* seconds since headless_init(), stands in for glfwGetTime() */
+double headless_get_time();
+
+/* call at end of each frame in place of glfwSwapBuffers(...) */
+void headless_swap_buffers();
+
+/* enable headless mode -- call before any GL use, instead of glewInit() */
+void headless_init();
+void headless_deinit(); /* prints totals over the whole run */
+
+#endif
+
@@ -6,6 +6,7 @@
 #include "array.h"
 #include "glew_glfw.h"
 #include "game.h"
+#include "headless.h"
 
 /* callback lists */
 static Array *key_down_cbs;
@@ -59,12 +60,16 @@ KeyCode input_char_to_keycode(char c)
 bool input_key_down(KeyCode key)
 {
     int glfwkey = _keycode_to_glfw(key);
+    if (headless_get_enabled())
+        return false;
     return glfwGetKey(game_window, glfwkey) == GLFW_PRESS;
 }
 
 Vec2 input_get_mouse_pos_pixels()
 {
     double x, y;
+    if (headless_get_enabled())
+        return vec2_zero;
     glfwGetCursorPos(game_window, &x, &y);
     return vec2(x, -y);
 }
@@ -76,6 +81,8 @@ Vec2 input_get_mouse_pos_unit()
 bool input_mouse_down(MouseCode mouse)
 {
     int glfwmouse = _mousecode_to_glfw(mouse);
+    if (headless_get_enabled())
+        return false;
     return glfwGetMouseButton(game_window, glfwmouse) == GLFW_PRESS;
 }
 
@@ -179,19 +186,20 @@ void input_init()
 {
     key_down_cbs = array_new(KeyCallback);
     key_up_cbs = array_new(KeyCallback);
-    glfwSetKeyCallback(game_window, _key_callback);
-
     char_down_cbs = array_new(CharCallback);
-    glfwSetCharCallback(game_window, _char_callback);
-
     mouse_down_cbs = array_new(MouseCallback);
     mouse_up_cbs = array_new(MouseCallback);
-    glfwSetMouseButtonCallback(game_window, _mouse_callback);
-
     mouse_move_cbs = array_new(MouseMoveCallback);
-    glfwSetCursorPosCallback(game_window, _cursor_pos_callback);
-
     scroll_cbs = array_new(ScrollCallback);
+
+    /* no window to get events from when headless, callbacks never fire */
+    if (headless_get_enabled())
+        return;
+
+    glfwSetKeyCallback(game_window, _key_callback);
+    glfwSetCharCallback(game_window, _char_callback);
+    glfwSetMouseButtonCallback(game_window, _mouse_callback);
+    glfwSetCursorPosCallback(game_window, _cursor_pos_callback);
     glfwSetScrollCallback(game_window, _scroll_callback);
 }
 
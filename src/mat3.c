@@ -4,6 +4,15 @@
 
 #include "saveload.h"
 
+#if defined(__SSE__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAT3_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MAT3_NEON
+#include <arm_neon.h>
+#endif
+
 Mat3 mat3_mul(Mat3 m, Mat3 n)
 {
     return mat3(
@@ -85,6 +94,114 @@ Vec2 mat3_transform(Mat3 m, Vec2 v)
         );
 }
 
+/* ------------------------------------------------------------------------- */
+
+Affine mat3_to_affine(Mat3 m)
+{
+    Affine a;
+
+    a.m[0][0] = m.m[0][0]; a.m[0][1] = m.m[0][1];
+    a.m[1][0] = m.m[1][0]; a.m[1][1] = m.m[1][1];
+    a.m[2][0] = m.m[2][0]; a.m[2][1] = m.m[2][1];
+    return a;
+}
+Mat3 mat3_from_affine(Affine a)
+{
+    return mat3(a.m[0][0], a.m[0][1], 0.0f,
+                a.m[1][0], a.m[1][1], 0.0f,
+                a.m[2][0], a.m[2][1], 1.0f);
+}
+
+/*
+ * the SIMD path works one matrix at a time with columns packed in
+ * registers -- an Affine is only six Scalars, so wider registers (AVX)
+ * would need a structure-of-arrays layout to help
+ */
+
+void mat3_affine_inverse_n(unsigned int n, const Affine *ms, Affine *out)
+{
+    unsigned int i;
+    Scalar det, idet;
+
+#if defined(MAT3_SSE)
+    __m128 m01, m2, sign, adj, inv01, r2;
+
+    sign = _mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f);
+
+    for (i = 0; i < n; ++i)
+    {
+        det = ms[i].m[0][0] * ms[i].m[1][1] - ms[i].m[1][0] * ms[i].m[0][1];
+        idet = det > 10e-8 || det < -10e-8 ? 1.0f / det : 1.0f;
+
+        m01 = _mm_loadu_ps(&ms[i].m[0][0]);
+        m2 = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) ms[i].m[2]);
+
+        /* inverse of linear part is (m11, -m01, -m10, m00) / det */
+        adj = _mm_shuffle_ps(m01, m01, _MM_SHUFFLE(0, 2, 1, 3));
+        inv01 = _mm_mul_ps(_mm_mul_ps(adj, sign), _mm_set1_ps(idet));
+
+        /* translation is -(inverse linear part) * m2 */
+        r2 = _mm_add_ps(
+            _mm_mul_ps(inv01, _mm_shuffle_ps(m2, m2, _MM_SHUFFLE(0, 0, 0, 0))),
+            _mm_mul_ps(_mm_movehl_ps(inv01, inv01),
+                       _mm_shuffle_ps(m2, m2, _MM_SHUFFLE(1, 1, 1, 1))));
+        r2 = _mm_sub_ps(_mm_setzero_ps(), r2);
+
+        _mm_storeu_ps(&out[i].m[0][0], inv01);
+        _mm_storel_pi((__m64 *) out[i].m[2], r2);
+    }
+#elif defined(MAT3_NEON)
+    static const float sign_[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+    float32x4_t m01, sign, adj, inv01;
+    float32x2x2_t z;
+    float32x2_t m2, r2;
+
+    sign = vld1q_f32(sign_);
+
+    for (i = 0; i < n; ++i)
+    {
+        det = ms[i].m[0][0] * ms[i].m[1][1] - ms[i].m[1][0] * ms[i].m[0][1];
+        idet = det > 10e-8 || det < -10e-8 ? 1.0f / det : 1.0f;
+
+        m01 = vld1q_f32(&ms[i].m[0][0]);
+        m2 = vld1_f32(ms[i].m[2]);
+
+        /* inverse of linear part is (m11, -m01, -m10, m00) / det */
+        z = vzip_f32(vget_high_f32(m01), vget_low_f32(m01));
+        adj = vcombine_f32(z.val[1], z.val[0]);
+        inv01 = vmulq_n_f32(vmulq_f32(adj, sign), idet);
+
+        /* translation is -(inverse linear part) * m2 */
+        r2 = vmul_lane_f32(vget_low_f32(inv01), m2, 0);
+        r2 = vmla_lane_f32(r2, vget_high_f32(inv01), m2, 1);
+        r2 = vneg_f32(r2);
+
+        vst1q_f32(&out[i].m[0][0], inv01);
+        vst1_f32(out[i].m[2], r2);
+    }
+#else
+    Affine m;
+
+    for (i = 0; i < n; ++i)
+    {
+        m = ms[i];
+        det = m.m[0][0] * m.m[1][1] - m.m[1][0] * m.m[0][1];
+        idet = det > 10e-8 || det < -10e-8 ? 1.0f / det : 1.0f;
+
+        out[i].m[0][0] = m.m[1][1] * idet;
+        out[i].m[0][1] = -m.m[0][1] * idet;
+        out[i].m[1][0] = -m.m[1][0] * idet;
+        out[i].m[1][1] = m.m[0][0] * idet;
+        out[i].m[2][0] = -(out[i].m[0][0] * m.m[2][0]
+                           + out[i].m[1][0] * m.m[2][1]);
+        out[i].m[2][1] = -(out[i].m[0][1] * m.m[2][0]
+                           + out[i].m[1][1] * m.m[2][1]);
+    }
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+
 void mat3_save(Mat3 *m, const char *n, Store *s)
 {
     Store *t;
@@ -133,3 +250,77 @@ Mat3 mat3(Scalar m00, Scalar m01, Scalar m02,
         }
     };
 }
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef MAT3_BENCH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N 4096
+#define ROUNDS 2000
+
+static double _secs(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static bool _close(Mat3 m, Affine a)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < 3; ++i)
+        for (j = 0; j < 2; ++j)
+            if (fabsf(m.m[i][j] - a.m[i][j]) > 1e-3f)
+                return false;
+    return true;
+}
+
+int main()
+{
+    static Mat3 ms[N], mout[N];
+    static Affine as[N], aout[N];
+    unsigned int i, r;
+    clock_t start;
+    Scalar sum = 0;
+
+    srand(42);
+    for (i = 0; i < N; ++i)
+    {
+        ms[i] = mat3_scaling_rotation_translation(
+            vec2(0.5f + rand() / (Scalar) RAND_MAX, 1.5f),
+            6.0f * rand() / (Scalar) RAND_MAX,
+            vec2(rand() % 100, rand() % 100));
+        as[i] = mat3_to_affine(ms[i]);
+    }
+
+    start = clock();
+    for (r = 0; r < ROUNDS; ++r)
+    {
+        for (i = 0; i < N; ++i)
+            mout[i] = mat3_inverse(ms[i]);
+        sum += mout[r % N].m[2][0];
+    }
+    printf("inverse    mat3: %.3fs\n", _secs(start));
+    start = clock();
+    for (r = 0; r < ROUNDS; ++r)
+    {
+        mat3_affine_inverse_n(N, as, aout);
+        sum += aout[r % N].m[2][0];
+    }
+    printf("inverse  affine: %.3fs\n", _secs(start));
+
+    /* check against the Mat3 version */
+    mat3_affine_inverse_n(N, as, aout);
+    for (i = 0; i < N; ++i)
+        if (!_close(mat3_inverse(ms[i]), aout[i]))
+            printf("inverse mismatch at %u\n", i);
+
+    printf("(%f)\n", sum); /* keep the optimizer honest */
+
+    return 0;
+}
+
+#endif
@@ -43,6 +43,28 @@ SCRIPT(mat3,
        EXPORT void mat3_save(Mat3 *m, const char *n, Store *s);
        EXPORT bool mat3_load(Mat3 *m, const char *n, Mat3 d, Store *s);
 
+       /*
+        * compact 2d affine matrix -- the first two rows of a Mat3 whose
+        * last row is (0, 0, 1), column-major like Mat3, so that,
+        *
+        *     a = /                                 \
+        *         | a.m[0][0]  a.m[1][0]  a.m[2][0] |
+        *         | a.m[0][1]  a.m[1][1]  a.m[2][1] |
+        *         \                                 /
+        */
+       typedef struct Affine Affine;
+       struct Affine { Scalar m[3][2]; };
+
+       EXPORT Affine mat3_to_affine(Mat3 m);
+       EXPORT Mat3 mat3_from_affine(Affine a);
+
+       /*
+        * inverse of n matrices at once, SIMD where available -- out may
+        * be the same array as ms
+        */
+       EXPORT void mat3_affine_inverse_n(unsigned int n, const Affine *ms,
+                                         Affine *out);
+
     )
 
 /* C inline stuff */
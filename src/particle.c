@@ -0,0 +1,704 @@
+#include "particle.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLE_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PARTICLE_NEON
+#include <arm_neon.h>
+#endif
+
+#include "glew_glfw.h"
+
+#include "error.h"
+#include "dirs.h"
+#include "mat3.h"
+#include "bbox.h"
+#include "frame.h"
+#include "gfx.h"
+#include "texture.h"
+#include "transform.h"
+#include "camera.h"
+#include "sprite.h"
+#include "timing.h"
+#include "edit.h"
+
+#define ALIGN 16 /* of each column */
+
+/*
+ * particle state as one array per field, each ALIGN-aligned and with space
+ * for a multiple of 4 particles, so the update kernel can run over whole
+ * groups of 4 -- dead particles are replaced by the last live one, so the
+ * live ones are always the first n
+ */
+typedef struct Particles Particles;
+struct Particles
+{
+    void *mem; /* as returned by malloc(...), all columns in one block */
+    Scalar *x, *y;
+    Scalar *vx, *vy;
+    Scalar *life; /* seconds left */
+    Scalar *texcell_x; /* texcell y is the emitter's */
+
+    unsigned int n; /* number alive */
+    unsigned int capacity;
+};
+
+typedef struct Emitter Emitter;
+struct Emitter
+{
+    EntityPoolElem pool_elem;
+
+    Scalar rate;
+    bool emitting;
+    Scalar accum; /* fractional particles owed by rate */
+    unsigned int max;
+    Scalar life;
+
+    Vec2 area;
+    Vec2 velocity;
+    Vec2 velocity_spread;
+    Vec2 gravity;
+
+    char *atlas; /* NULL for default sprite atlas */
+    Vec2 size;
+    Vec2 texcell;
+    Vec2 texsize;
+    unsigned int nframes;
+
+    Particles particles;
+    BBox bbox; /* world space bound of live particles, after update */
+
+    GLuint vao, vbo;
+};
+
+/* same layout as sprite instances, we use the sprite shaders */
+typedef struct ParticleInstance ParticleInstance;
+struct ParticleInstance
+{
+    Affine wmat;
+    Vec2 size;
+    Vec2 texcell;
+    Vec2 texsize;
+};
+
+static GLuint program;
+
+static EntityPool *pool;
+
+/* ------------------------------------------------------------------------- */
+
+/* allocate columns for capacity particles, keep the live ones */
+static void _particles_realloc(Particles *p, unsigned int capacity)
+{
+    void *mem;
+    Scalar *buf;
+    Particles q;
+
+    capacity = (capacity + 3) & ~3U;
+    mem = calloc(6 * capacity * sizeof(Scalar) + ALIGN - 1, 1);
+    buf = (Scalar *) (((uintptr_t) mem + ALIGN - 1)
+                      & ~((uintptr_t) ALIGN - 1));
+
+    q.mem = mem;
+    q.x = buf;
+    q.y = q.x + capacity;
+    q.vx = q.y + capacity;
+    q.vy = q.vx + capacity;
+    q.life = q.vy + capacity;
+    q.texcell_x = q.life + capacity;
+    q.n = p->n < capacity ? p->n : capacity;
+    q.capacity = capacity;
+
+    if (p->mem)
+    {
+        memcpy(q.x, p->x, q.n * sizeof(Scalar));
+        memcpy(q.y, p->y, q.n * sizeof(Scalar));
+        memcpy(q.vx, p->vx, q.n * sizeof(Scalar));
+        memcpy(q.vy, p->vy, q.n * sizeof(Scalar));
+        memcpy(q.life, p->life, q.n * sizeof(Scalar));
+        memcpy(q.texcell_x, p->texcell_x, q.n * sizeof(Scalar));
+        free(p->mem);
+    }
+    *p = q;
+}
+
+/* move particle j into slot i */
+static void _particles_move(Particles *p, unsigned int i, unsigned int j)
+{
+    p->x[i] = p->x[j];
+    p->y[i] = p->y[j];
+    p->vx[i] = p->vx[j];
+    p->vy[i] = p->vy[j];
+    p->life[i] = p->life[j];
+    p->texcell_x[i] = p->texcell_x[j];
+}
+
+/*
+ * integrate velocity, position, life and pick frame for particles [0, n)
+ * -- frame is (1 - life / emitter life) * nframes clamped to
+ * [0, nframes - 1], texcell_x = base + frame * step
+ */
+static void _particles_kernel(Particles *p, Scalar dt, Vec2 gravity,
+                              Scalar life, unsigned int nframes,
+                              Scalar base, Scalar step)
+{
+    unsigned int i, n;
+    Scalar inv_life, fn;
+#if defined(PARTICLE_SSE)
+    __m128 dtv, gx, gy, il, nf, nf1, zero, one, basev, stepv;
+    __m128 vx, vy, l, f;
+#elif defined(PARTICLE_NEON)
+    float32x4_t dtv, gx, gy, il, nf, nf1, zero, one, basev, stepv;
+    float32x4_t vx, vy, l, f;
+#else
+    Scalar f;
+#endif
+
+    n = (p->n + 3) & ~3U; /* capacity is a multiple of 4, so this is ok */
+    inv_life = life > 0 ? 1 / life : 0;
+    fn = nframes > 0 ? nframes : 1;
+
+#if defined(PARTICLE_SSE)
+    dtv = _mm_set1_ps(dt);
+    gx = _mm_set1_ps(gravity.x * dt);
+    gy = _mm_set1_ps(gravity.y * dt);
+    il = _mm_set1_ps(inv_life);
+    nf = _mm_set1_ps(fn);
+    nf1 = _mm_set1_ps(fn - 1);
+    zero = _mm_setzero_ps();
+    one = _mm_set1_ps(1);
+    basev = _mm_set1_ps(base);
+    stepv = _mm_set1_ps(step);
+
+    for (i = 0; i < n; i += 4)
+    {
+        vx = _mm_add_ps(_mm_load_ps(p->vx + i), gx);
+        vy = _mm_add_ps(_mm_load_ps(p->vy + i), gy);
+        _mm_store_ps(p->vx + i, vx);
+        _mm_store_ps(p->vy + i, vy);
+        _mm_store_ps(p->x + i, _mm_add_ps(_mm_load_ps(p->x + i),
+                                          _mm_mul_ps(vx, dtv)));
+        _mm_store_ps(p->y + i, _mm_add_ps(_mm_load_ps(p->y + i),
+                                          _mm_mul_ps(vy, dtv)));
+
+        l = _mm_sub_ps(_mm_load_ps(p->life + i), dtv);
+        _mm_store_ps(p->life + i, l);
+
+        f = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(l, il)), nf);
+        f = _mm_cvtepi32_ps(_mm_cvttps_epi32(f));
+        f = _mm_min_ps(_mm_max_ps(f, zero), nf1);
+        _mm_store_ps(p->texcell_x + i, _mm_add_ps(basev,
+                                                  _mm_mul_ps(f, stepv)));
+    }
+#elif defined(PARTICLE_NEON)
+    dtv = vdupq_n_f32(dt);
+    gx = vdupq_n_f32(gravity.x * dt);
+    gy = vdupq_n_f32(gravity.y * dt);
+    il = vdupq_n_f32(inv_life);
+    nf = vdupq_n_f32(fn);
+    nf1 = vdupq_n_f32(fn - 1);
+    zero = vdupq_n_f32(0);
+    one = vdupq_n_f32(1);
+    basev = vdupq_n_f32(base);
+    stepv = vdupq_n_f32(step);
+
+    for (i = 0; i < n; i += 4)
+    {
+        vx = vaddq_f32(vld1q_f32(p->vx + i), gx);
+        vy = vaddq_f32(vld1q_f32(p->vy + i), gy);
+        vst1q_f32(p->vx + i, vx);
+        vst1q_f32(p->vy + i, vy);
+        vst1q_f32(p->x + i, vmlaq_f32(vld1q_f32(p->x + i), vx, dtv));
+        vst1q_f32(p->y + i, vmlaq_f32(vld1q_f32(p->y + i), vy, dtv));
+
+        l = vsubq_f32(vld1q_f32(p->life + i), dtv);
+        vst1q_f32(p->life + i, l);
+
+        f = vmulq_f32(vmlsq_f32(one, l, il), nf);
+        f = vcvtq_f32_s32(vcvtq_s32_f32(f));
+        f = vminq_f32(vmaxq_f32(f, zero), nf1);
+        vst1q_f32(p->texcell_x + i, vmlaq_f32(basev, f, stepv));
+    }
+#else
+    for (i = 0; i < n; ++i)
+    {
+        p->vx[i] += gravity.x * dt;
+        p->vy[i] += gravity.y * dt;
+        p->x[i] += p->vx[i] * dt;
+        p->y[i] += p->vy[i] * dt;
+        p->life[i] -= dt;
+
+        f = (int) ((1 - p->life[i] * inv_life) * fn);
+        f = f < 0 ? 0 : f > fn - 1 ? fn - 1 : f;
+        p->texcell_x[i] = base + f * step;
+    }
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+
+static Emitter *_get(Entity ent)
+{
+    Emitter *emitter = entitypool_get(pool, ent);
+    error_assert(emitter, "entity must be in particle system");
+    return emitter;
+}
+
+static const char *_atlas(Emitter *emitter)
+{
+    return emitter->atlas ? emitter->atlas : sprite_get_atlas();
+}
+
+/* uniform in [-a, a] */
+static inline Scalar _rand_spread(Scalar a)
+{
+    return a * (2 * (rand() / (Scalar) RAND_MAX) - 1);
+}
+
+static void _emit(Emitter *emitter, unsigned int n)
+{
+    Particles *p;
+    Mat3 wmat;
+    Scalar rot;
+    Vec2 pos, vel;
+    unsigned int i, room;
+
+    /* capacity is always at least max */
+    p = &emitter->particles;
+    room = emitter->max > p->n ? emitter->max - p->n : 0;
+    if (n > room)
+        n = room;
+    if (n == 0)
+        return;
+
+    wmat = transform_get_world_matrix(emitter->pool_elem.ent);
+    rot = mat3_get_rotation(wmat);
+    for (i = p->n; i < p->n + n; ++i)
+    {
+        pos = mat3_transform(wmat,
+                             vec2(_rand_spread(emitter->area.x),
+                                  _rand_spread(emitter->area.y)));
+        vel = vec2_rot(vec2_add(emitter->velocity,
+                                vec2(_rand_spread(emitter->velocity_spread.x),
+                                     _rand_spread(emitter->velocity_spread.y))),
+                       rot);
+        p->x[i] = pos.x;
+        p->y[i] = pos.y;
+        p->vx[i] = vel.x;
+        p->vy[i] = vel.y;
+        p->life[i] = emitter->life;
+        p->texcell_x[i] = emitter->texcell.x;
+    }
+    p->n += n;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void particle_add(Entity ent)
+{
+    Emitter *emitter;
+
+    if (entitypool_get(pool, ent))
+        return;
+
+    transform_add(ent);
+
+    emitter = entitypool_add(pool, ent);
+    emitter->rate = 10;
+    emitter->emitting = true;
+    emitter->accum = 0;
+    emitter->max = 256;
+    emitter->life = 1;
+    emitter->area = vec2_zero;
+    emitter->velocity = vec2(0, 1);
+    emitter->velocity_spread = vec2(0.5, 0.5);
+    emitter->gravity = vec2_zero;
+    emitter->atlas = NULL;
+    emitter->size = vec2(0.25, 0.25);
+    emitter->texcell = vec2(32, 32);
+    emitter->texsize = vec2(32, 32);
+    emitter->nframes = 1;
+
+    emitter->particles.mem = NULL;
+    emitter->particles.n = 0;
+    _particles_realloc(&emitter->particles, emitter->max);
+    emitter->bbox = bbox(vec2_zero, vec2_zero);
+
+    /* make vao, vbo, bind attributes */
+    glGenVertexArrays(1, &emitter->vao);
+    glBindVertexArray(emitter->vao);
+    glGenBuffers(1, &emitter->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, emitter->vbo);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat1",
+                           ParticleInstance, wmat.m[0]);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat2",
+                           ParticleInstance, wmat.m[1]);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat3",
+                           ParticleInstance, wmat.m[2]);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "size",
+                           ParticleInstance, size);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texcell",
+                           ParticleInstance, texcell);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texsize",
+                           ParticleInstance, texsize);
+}
+void particle_remove(Entity ent)
+{
+    Emitter *emitter;
+
+    emitter = entitypool_get(pool, ent);
+    if (emitter)
+    {
+        glDeleteBuffers(1, &emitter->vbo);
+        glDeleteVertexArrays(1, &emitter->vao);
+        free(emitter->particles.mem);
+        free(emitter->atlas);
+    }
+    entitypool_remove(pool, ent);
+}
+bool particle_has(Entity ent)
+{
+    return entitypool_get(pool, ent) != NULL;
+}
+EntityPool *particle_get_pool()
+{
+    return pool;
+}
+
+void particle_set_rate(Entity ent, Scalar rate)
+{
+    _get(ent)->rate = rate;
+}
+Scalar particle_get_rate(Entity ent)
+{
+    return _get(ent)->rate;
+}
+void particle_set_emitting(Entity ent, bool emitting)
+{
+    Emitter *emitter = _get(ent);
+    emitter->emitting = emitting;
+    emitter->accum = 0;
+}
+bool particle_get_emitting(Entity ent)
+{
+    return _get(ent)->emitting;
+}
+
+void particle_emit(Entity ent, unsigned int n)
+{
+    _emit(_get(ent), n);
+}
+
+void particle_set_max(Entity ent, unsigned int max)
+{
+    Emitter *emitter = _get(ent);
+    emitter->max = max;
+    _particles_realloc(&emitter->particles, max); /* drops any extra */
+}
+unsigned int particle_get_max(Entity ent)
+{
+    return _get(ent)->max;
+}
+
+void particle_set_life(Entity ent, Scalar life)
+{
+    _get(ent)->life = life;
+}
+Scalar particle_get_life(Entity ent)
+{
+    return _get(ent)->life;
+}
+
+void particle_set_area(Entity ent, Vec2 area)
+{
+    _get(ent)->area = area;
+}
+Vec2 particle_get_area(Entity ent)
+{
+    return _get(ent)->area;
+}
+void particle_set_velocity(Entity ent, Vec2 velocity)
+{
+    _get(ent)->velocity = velocity;
+}
+Vec2 particle_get_velocity(Entity ent)
+{
+    return _get(ent)->velocity;
+}
+void particle_set_velocity_spread(Entity ent, Vec2 spread)
+{
+    _get(ent)->velocity_spread = spread;
+}
+Vec2 particle_get_velocity_spread(Entity ent)
+{
+    return _get(ent)->velocity_spread;
+}
+
+void particle_set_gravity(Entity ent, Vec2 gravity)
+{
+    _get(ent)->gravity = gravity;
+}
+Vec2 particle_get_gravity(Entity ent)
+{
+    return _get(ent)->gravity;
+}
+
+void particle_set_atlas(Entity ent, const char *filename)
+{
+    Emitter *emitter;
+    char *name = NULL;
+
+    emitter = _get(ent);
+    if (filename)
+    {
+        sprite_load_atlas(filename, true);
+        name = malloc(strlen(filename) + 1);
+        strcpy(name, filename);
+    }
+    free(emitter->atlas); /* after copy, filename might be this */
+    emitter->atlas = name;
+}
+const char *particle_get_atlas(Entity ent)
+{
+    return _get(ent)->atlas;
+}
+
+void particle_set_size(Entity ent, Vec2 size)
+{
+    _get(ent)->size = size;
+}
+Vec2 particle_get_size(Entity ent)
+{
+    return _get(ent)->size;
+}
+void particle_set_texcell(Entity ent, Vec2 texcell)
+{
+    _get(ent)->texcell = texcell;
+}
+Vec2 particle_get_texcell(Entity ent)
+{
+    return _get(ent)->texcell;
+}
+void particle_set_texsize(Entity ent, Vec2 texsize)
+{
+    _get(ent)->texsize = texsize;
+}
+Vec2 particle_get_texsize(Entity ent)
+{
+    return _get(ent)->texsize;
+}
+
+void particle_set_nframes(Entity ent, unsigned int nframes)
+{
+    _get(ent)->nframes = nframes;
+}
+unsigned int particle_get_nframes(Entity ent)
+{
+    return _get(ent)->nframes;
+}
+
+void particle_clear(Entity ent)
+{
+    _get(ent)->particles.n = 0;
+}
+unsigned int particle_get_num(Entity ent)
+{
+    return _get(ent)->particles.n;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void particle_init()
+{
+    pool = entitypool_new(Emitter);
+
+    program = gfx_create_program(data_path("sprite.vert"),
+                                 data_path("sprite.geom"),
+                                 data_path("sprite.frag"));
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex0"), 0);
+}
+void particle_deinit()
+{
+    while (entitypool_size(pool) > 0)
+        particle_remove(((EntityPoolElem *) entitypool_begin(pool))->ent);
+    entitypool_free(pool);
+
+    glDeleteProgram(program);
+}
+
+void particle_update_all()
+{
+    Emitter *emitter;
+    Particles *p;
+    unsigned int i, k;
+    Vec2 half, pos;
+    BBox b;
+
+    entitypool_remove_destroyed(pool, particle_remove);
+
+    entitypool_foreach(emitter, pool)
+    {
+        p = &emitter->particles;
+
+        /* spawn what the rate owes us */
+        if (emitter->emitting && emitter->rate > 0)
+        {
+            emitter->accum += emitter->rate * timing_dt;
+            k = (unsigned int) emitter->accum;
+            emitter->accum -= k;
+            _emit(emitter, k);
+        }
+
+        _particles_kernel(p, timing_dt, emitter->gravity, emitter->life,
+                          emitter->nframes, emitter->texcell.x,
+                          emitter->texsize.x);
+
+        /* remove dead, bound live */
+        half = vec2_scalar_mul(emitter->size, 0.5);
+        b = bbox(vec2_zero, vec2_zero);
+        for (i = 0; i < p->n; )
+        {
+            if (p->life[i] <= 0)
+            {
+                _particles_move(p, i, --p->n);
+                continue;
+            }
+            pos = vec2(p->x[i], p->y[i]);
+            if (i == 0)
+                b = bbox(pos, pos);
+            else
+                b = bbox_merge(b, bbox(pos, pos));
+            ++i;
+        }
+        b.min = vec2_sub(b.min, half);
+        b.max = vec2_add(b.max, half);
+        emitter->bbox = b;
+
+        edit_bboxes_update(emitter->pool_elem.ent,
+                           bbox(vec2_neg(vec2_add(emitter->area, half)),
+                                vec2_add(emitter->area, half)));
+    }
+}
+
+void particle_draw_all()
+{
+    Emitter *emitter;
+    Particles *p;
+    ParticleInstance *instances, *inst;
+    const char *atlas;
+    Vec2 atlas_size;
+    unsigned int i;
+
+    glUseProgram(program);
+    glUniformMatrix3fv(glGetUniformLocation(program, "inverse_view_matrix"),
+                       1, GL_FALSE,
+                       (const GLfloat *) camera_get_inverse_view_matrix_ptr());
+    glActiveTexture(GL_TEXTURE0);
+
+    /* a draw call per visible emitter */
+    entitypool_foreach(emitter, pool)
+    {
+        p = &emitter->particles;
+        if (p->n == 0 || !camera_in_view(emitter->bbox))
+            continue;
+
+        /* interleave for the shader */
+        instances = frame_alloc(p->n * sizeof(ParticleInstance));
+        for (i = 0, inst = instances; i < p->n; ++i, ++inst)
+        {
+            inst->wmat.m[0][0] = 1; inst->wmat.m[0][1] = 0;
+            inst->wmat.m[1][0] = 0; inst->wmat.m[1][1] = 1;
+            inst->wmat.m[2][0] = p->x[i]; inst->wmat.m[2][1] = p->y[i];
+            inst->size = emitter->size;
+            inst->texcell = vec2(p->texcell_x[i], emitter->texcell.y);
+            inst->texsize = emitter->texsize;
+        }
+
+        atlas = _atlas(emitter);
+        texture_bind(atlas);
+        atlas_size = texture_get_size(atlas);
+        glUniform2fv(glGetUniformLocation(program, "atlas_size"), 1,
+                     (const GLfloat *) &atlas_size);
+
+        glBindVertexArray(emitter->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, emitter->vbo);
+        glBufferData(GL_ARRAY_BUFFER, p->n * sizeof(ParticleInstance),
+                     instances, GL_STREAM_DRAW);
+        glDrawArrays(GL_POINTS, 0, p->n);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+void particle_save_all(Store *s)
+{
+    Store *t, *emitter_s;
+    Emitter *emitter;
+
+    if (store_child_save(&t, "particle", s))
+        entitypool_save_foreach(emitter, emitter_s, pool, "pool", t)
+        {
+            scalar_save(&emitter->rate, "rate", emitter_s);
+            bool_save(&emitter->emitting, "emitting", emitter_s);
+            uint_save(&emitter->max, "max", emitter_s);
+            scalar_save(&emitter->life, "life", emitter_s);
+            vec2_save(&emitter->area, "area", emitter_s);
+            vec2_save(&emitter->velocity, "velocity", emitter_s);
+            vec2_save(&emitter->velocity_spread, "velocity_spread",
+                      emitter_s);
+            vec2_save(&emitter->gravity, "gravity", emitter_s);
+            string_save((const char **) &emitter->atlas, "atlas", emitter_s);
+            vec2_save(&emitter->size, "size", emitter_s);
+            vec2_save(&emitter->texcell, "texcell", emitter_s);
+            vec2_save(&emitter->texsize, "texsize", emitter_s);
+            uint_save(&emitter->nframes, "nframes", emitter_s);
+        }
+}
+void particle_load_all(Store *s)
+{
+    Store *t, *pool_s, *emitter_s;
+    Emitter *emitter;
+    Entity ent;
+    char *atlas;
+    unsigned int max;
+
+    if (store_child_load(&t, "particle", s)
+        && store_child_load(&pool_s, "pool", t))
+        while (store_child_load(&emitter_s, NULL, pool_s))
+        {
+            /* replace whatever was there, particles are allocated per entity */
+            error_assert(entity_load(&ent, "pool_elem", entity_nil,
+                                     emitter_s),
+                         "saved EntityPoolElem entry must exist");
+            particle_remove(ent);
+            particle_add(ent);
+
+            string_load(&atlas, "atlas", NULL, emitter_s);
+            particle_set_atlas(ent, atlas);
+            free(atlas);
+
+            uint_load(&max, "max", 256, emitter_s);
+            particle_set_max(ent, max);
+
+            emitter = entitypool_get(pool, ent);
+            scalar_load(&emitter->rate, "rate", 10, emitter_s);
+            bool_load(&emitter->emitting, "emitting", true, emitter_s);
+            scalar_load(&emitter->life, "life", 1, emitter_s);
+            vec2_load(&emitter->area, "area", vec2_zero, emitter_s);
+            vec2_load(&emitter->velocity, "velocity", vec2(0, 1), emitter_s);
+            vec2_load(&emitter->velocity_spread, "velocity_spread",
+                      vec2(0.5, 0.5), emitter_s);
+            vec2_load(&emitter->gravity, "gravity", vec2_zero, emitter_s);
+            vec2_load(&emitter->size, "size", vec2(0.25, 0.25), emitter_s);
+            vec2_load(&emitter->texcell, "texcell", vec2(32, 32), emitter_s);
+            vec2_load(&emitter->texsize, "texsize", vec2(32, 32), emitter_s);
+            uint_load(&emitter->nframes, "nframes", 1, emitter_s);
+        }
+}
@@ -0,0 +1,94 @@
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+#include "saveload.h"
+#include "entity.h"
+#include "entitypool.h"
+#include "vec2.h"
+#include "script_export.h"
+
+/*
+ * particle emitters -- an emitter entity spawns particles at its world
+ * position, which then move in world space under gravity till their life
+ * runs out, drawn as sprites with the emitter's size and texsize
+ *
+ * particles aren't entities and can't be touched one by one, only the
+ * emitter's parameters can be set -- each emitter is one draw call, drawn
+ * over sprites
+ *
+ * only the parameters are saved, live particles aren't
+ */
+
+SCRIPT(particle,
+
+       EXPORT void particle_add(Entity ent); /* also adds transform */
+       EXPORT void particle_remove(Entity ent);
+       EXPORT bool particle_has(Entity ent);
+       EXPORT EntityPool *particle_get_pool(); /* for entitypool_join_*() */
+
+       /* particles spawned per second while emitting */
+       EXPORT void particle_set_rate(Entity ent, Scalar rate);
+       EXPORT Scalar particle_get_rate(Entity ent);
+       EXPORT void particle_set_emitting(Entity ent, bool emitting);
+       EXPORT bool particle_get_emitting(Entity ent);
+
+       /* spawn n particles now, even if not emitting */
+       EXPORT void particle_emit(Entity ent, unsigned int n);
+
+       /* most particles alive at once, spawning stops at this many */
+       EXPORT void particle_set_max(Entity ent, unsigned int max);
+       EXPORT unsigned int particle_get_max(Entity ent);
+
+       /* seconds a particle lives */
+       EXPORT void particle_set_life(Entity ent, Scalar life);
+       EXPORT Scalar particle_get_life(Entity ent);
+
+       /*
+        * spawn position is uniformly within +/- area of the emitter's
+        * origin in its space, velocity is velocity +/- velocity_spread
+        * rotated by the emitter's world rotation
+        */
+       EXPORT void particle_set_area(Entity ent, Vec2 area);
+       EXPORT Vec2 particle_get_area(Entity ent);
+       EXPORT void particle_set_velocity(Entity ent, Vec2 velocity);
+       EXPORT Vec2 particle_get_velocity(Entity ent);
+       EXPORT void particle_set_velocity_spread(Entity ent, Vec2 spread);
+       EXPORT Vec2 particle_get_velocity_spread(Entity ent);
+
+       /* world space acceleration */
+       EXPORT void particle_set_gravity(Entity ent, Vec2 gravity);
+       EXPORT Vec2 particle_get_gravity(Entity ent);
+
+       /* atlas to draw from, NULL means the default sprite atlas */
+       EXPORT void particle_set_atlas(Entity ent, const char *filename);
+       EXPORT const char *particle_get_atlas(Entity ent);
+
+       /* like sprite size, texcell, texsize */
+       EXPORT void particle_set_size(Entity ent, Vec2 size);
+       EXPORT Vec2 particle_get_size(Entity ent);
+       EXPORT void particle_set_texcell(Entity ent, Vec2 texcell);
+       EXPORT Vec2 particle_get_texcell(Entity ent);
+       EXPORT void particle_set_texsize(Entity ent, Vec2 texsize);
+       EXPORT Vec2 particle_get_texsize(Entity ent);
+
+       /*
+        * number of frames a particle goes through over its life, going
+        * right from texcell in steps of texsize
+        */
+       EXPORT void particle_set_nframes(Entity ent, unsigned int nframes);
+       EXPORT unsigned int particle_get_nframes(Entity ent);
+
+       EXPORT void particle_clear(Entity ent); /* kill all particles */
+       EXPORT unsigned int particle_get_num(Entity ent); /* alive */
+
+    )
+
+void particle_init();
+void particle_deinit();
+void particle_update_all();
+void particle_draw_all();
+void particle_save_all(Store *s);
+void particle_load_all(Store *s);
+
+#endif
+
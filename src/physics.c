@@ -14,6 +14,7 @@
 #include "camera.h"
 #include "edit.h"
 #include "entitymap.h"
+#include "frame.h"
 
 /* per-entity info */
 typedef struct PhysicsInfo PhysicsInfo;
@@ -32,10 +33,19 @@ struct PhysicsInfo
 
     /* used to keep track of transform <-> physics update */
     unsigned int last_dirty_count;
+    cpVect sync_pos; /* pose last written to or read from transform */
+    cpFloat sync_ang;
+
+    /* pose before last step, for interpolation */
+    cpVect prev_pos;
+    cpFloat prev_ang;
 
     cpBody *body;
     Array *shapes;
-    Array *collisions;
+
+    /* in frame memory, NULL if not gathered this frame */
+    Collision *collisions;
+    unsigned int ncollisions;
 };
 
 /* per-shape info for each shape attached to a physics entity */
@@ -48,8 +58,20 @@ struct ShapeInfo
 
 static cpSpace *space;
 static Scalar period = 1.0 / 60.0; /* 1.0 / simulation_frequency */
+static Scalar remain = 0.0; /* time not yet simulated, less than period */
+static bool interpolation = false;
+static unsigned int max_steps = 8;
 static EntityPool *pool;
 
+static unsigned int num_synced = 0, num_sleeping = 0; /* in last update */
+static unsigned int num_steps = 0; /* in last update */
+static unsigned int num_dropped_steps = 0; /* ever */
+
+/* collision events since last physics_post_update_all() */
+static CollisionEvent *events = NULL;
+static unsigned int nevents = 0, events_capacity = 0;
+static unsigned int events_mask = ~0U; /* bit i set if type i has events */
+
 static EntityMap *debug_draw_map;
 
 /* ------------------------------------------------------------------------- */
@@ -72,6 +94,17 @@ static inline void _remove_shape(cpShape *shape)
     cpShapeFree(shape);
 }
 
+/* move body, waking anything touching it */
+static void _set_pos_ang(PhysicsInfo *info, cpVect pos, cpFloat ang)
+{
+    cpBodySetPos(info->body, pos);
+    cpBodySetAngle(info->body, ang);
+    if (cpBodyIsStatic(info->body))
+        cpBodyActivateStatic(info->body, NULL);
+    info->sync_pos = info->prev_pos = pos;
+    info->sync_ang = info->prev_ang = ang;
+}
+
 /* ------------------------------------------------------------------------- */
 
 void physics_set_gravity(Vec2 g)
@@ -92,6 +125,58 @@ Scalar physics_get_simulation_frequency()
     return 1.0 / period;
 }
 
+void physics_set_sleep_time(Scalar t)
+{
+    cpSpaceSetSleepTimeThreshold(space, t);
+}
+Scalar physics_get_sleep_time()
+{
+    return cpSpaceGetSleepTimeThreshold(space);
+}
+
+void physics_set_interpolation(bool interp)
+{
+    PhysicsInfo *info;
+
+    /* don't blend from poses saved long ago */
+    if (interp && !interpolation)
+        entitypool_foreach(info, pool)
+        {
+            info->prev_pos = cpBodyGetPos(info->body);
+            info->prev_ang = cpBodyGetAngle(info->body);
+        }
+    interpolation = interp;
+}
+bool physics_get_interpolation()
+{
+    return interpolation;
+}
+void physics_set_max_steps(unsigned int m)
+{
+    max_steps = m;
+}
+unsigned int physics_get_max_steps()
+{
+    return max_steps;
+}
+
+unsigned int physics_get_num_synced()
+{
+    return num_synced;
+}
+unsigned int physics_get_num_sleeping()
+{
+    return num_sleeping;
+}
+unsigned int physics_get_num_steps()
+{
+    return num_steps;
+}
+unsigned int physics_get_num_dropped_steps()
+{
+    return num_dropped_steps;
+}
+
 void physics_add(Entity ent)
 {
     PhysicsInfo *info;
@@ -109,8 +194,8 @@ void physics_add(Entity ent)
     /* create, init cpBody */
     info->body = cpSpaceAddBody(space, cpBodyNew(info->mass, 1.0));
     cpBodySetUserData(info->body, ent); /* for cpBody -> Entity mapping */
-    cpBodySetPos(info->body, cpv_of_vec2(transform_get_position(ent)));
-    cpBodySetAngle(info->body, transform_get_rotation(ent));
+    _set_pos_ang(info, cpv_of_vec2(transform_get_position(ent)),
+                 transform_get_rotation(ent));
     info->last_dirty_count = transform_get_dirty_count(ent);
 
     /* initially no shapes */
@@ -151,6 +236,10 @@ bool physics_has(Entity ent)
 {
     return entitypool_get(pool, ent) != NULL;
 }
+EntityPool *physics_get_pool()
+{
+    return pool;
+}
 
 /* calculate moment for a single shape */
 static Scalar _moment(cpBody *body, ShapeInfo *shapeInfo)
@@ -229,6 +318,13 @@ PhysicsBody physics_get_type(Entity ent)
     return info->type;
 }
 
+bool physics_get_sleeping(Entity ent)
+{
+    PhysicsInfo *info = entitypool_get(pool, ent);
+    error_assert(info);
+    return cpBodyIsSleeping(info->body);
+}
+
 void physics_debug_draw(Entity ent)
 {
     entitymap_set(debug_draw_map, ent, true);
@@ -390,6 +486,22 @@ bool physics_shape_get_sensor(Entity ent,
     return cpShapeGetSensor(_get_shape(info, i)->shape);
 }
 
+void physics_shape_set_collision_type(Entity ent,
+                                      unsigned int i,
+                                      unsigned int type)
+{
+    PhysicsInfo *info = entitypool_get(pool, ent);
+    error_assert(info);
+    cpShapeSetCollisionType(_get_shape(info, i)->shape, type);
+}
+unsigned int physics_shape_get_collision_type(Entity ent,
+                                              unsigned int i)
+{
+    PhysicsInfo *info = entitypool_get(pool, ent);
+    error_assert(info);
+    return cpShapeGetCollisionType(_get_shape(info, i)->shape);
+}
+
 /* --- dynamics ------------------------------------------------------------ */
 
 void physics_set_mass(Entity ent, Scalar mass)
@@ -536,8 +648,13 @@ void physics_apply_impulse_at(Entity ent, Vec2 impulse, Vec2 at)
 
 /* --- collisions ---------------------------------------------------------- */
 
-static void _add_collision(cpBody *body, cpArbiter *arbiter, void *collisions)
+static void _count_collision(cpBody *body, cpArbiter *arbiter, void *n)
+{
+    ++*((unsigned int *) n);
+}
+static void _add_collision(cpBody *body, cpArbiter *arbiter, void *data)
 {
+    PhysicsInfo *info = data;
     cpBody *ba, *bb;
     Collision *col;
 
@@ -545,23 +662,28 @@ static void _add_collision(cpBody *body, cpArbiter *arbiter, void *collisions)
     cpArbiterGetBodies(arbiter, &ba, &bb);
     if (bb == body)
     {
-        ba = body;
         bb = ba;
+        ba = body;
     }
 
     /* save collision */
-    col = array_add(collisions);
+    col = &info->collisions[info->ncollisions++];
     col->a = cpBodyGetUserData(ba);
     col->b = cpBodyGetUserData(bb);
 }
 static void _update_collisions(PhysicsInfo *info)
 {
+    unsigned int n;
+
     if (info->collisions)
         return;
 
-    /* gather collisions */
-    info->collisions = array_new(Collision);
-    cpBodyEachArbiter(info->body, _add_collision, info->collisions);
+    /* count, then gather collisions */
+    n = 0;
+    cpBodyEachArbiter(info->body, _count_collision, &n);
+    info->collisions = frame_alloc(n * sizeof(Collision));
+    info->ncollisions = 0;
+    cpBodyEachArbiter(info->body, _add_collision, info);
 }
 
 unsigned int physics_get_num_collisions(Entity ent)
@@ -570,7 +692,7 @@ unsigned int physics_get_num_collisions(Entity ent)
     error_assert(info);
 
     _update_collisions(info);
-    return array_length(info->collisions);
+    return info->ncollisions;
 }
 Collision *physics_get_collisions(Entity ent)
 {
@@ -578,9 +700,84 @@ Collision *physics_get_collisions(Entity ent)
     error_assert(info);
 
     _update_collisions(info);
-    return array_begin(info->collisions);
+    return info->collisions;
+}
+
+static bool _type_has_events(cpCollisionType type)
+{
+    return type < 32 && (events_mask >> type) & 1;
+}
+static void _add_event(cpArbiter *arbiter, CollisionEventType type,
+                       Scalar impulse)
+{
+    CollisionEvent *event;
+    cpShape *sa, *sb;
+
+    cpArbiterGetShapes(arbiter, &sa, &sb);
+    if (!_type_has_events(cpShapeGetCollisionType(sa))
+        && !_type_has_events(cpShapeGetCollisionType(sb)))
+        return;
+
+    /* too small? double it */
+    if (nevents == events_capacity)
+    {
+        events_capacity = events_capacity ? events_capacity << 1 : 64;
+        events = realloc(events, events_capacity * sizeof(CollisionEvent));
+    }
+
+    event = &events[nevents++];
+    event->type = type;
+    event->a = cpShapeGetUserData(sa);
+    event->b = cpShapeGetUserData(sb);
+    event->normal = type == CE_BEGIN && cpArbiterGetCount(arbiter) > 0
+        ? vec2_of_cpv(cpArbiterGetNormal(arbiter, 0)) : vec2_zero;
+    event->impulse = impulse;
 }
 
+/* chipmunk callbacks */
+static cpBool _begin(cpArbiter *arbiter, cpSpace *space, void *data)
+{
+    cpShape *sa, *sb;
+
+    /* sensors are never solved, report them here */
+    cpArbiterGetShapes(arbiter, &sa, &sb);
+    if (cpShapeGetSensor(sa) || cpShapeGetSensor(sb))
+        _add_event(arbiter, CE_BEGIN, 0);
+    return cpTrue;
+}
+static void _post_solve(cpArbiter *arbiter, cpSpace *space, void *data)
+{
+    /* solid contacts are reported after the first solve, with impulse */
+    if (cpArbiterIsFirstContact(arbiter))
+        _add_event(arbiter, CE_BEGIN,
+                   cpvlength(cpArbiterTotalImpulse(arbiter)));
+}
+static void _separate(cpArbiter *arbiter, cpSpace *space, void *data)
+{
+    _add_event(arbiter, CE_END, 0);
+}
+
+unsigned int physics_get_num_collision_events()
+{
+    return nevents;
+}
+CollisionEvent *physics_get_collision_events()
+{
+    return events;
+}
+
+void physics_set_collision_events(unsigned int type, bool enabled)
+{
+    error_assert(type < 32, "only collision types below 32 can have events");
+    if (enabled)
+        events_mask |= 1U << type;
+    else
+        events_mask &= ~(1U << type);
+}
+bool physics_get_collision_events_enabled(unsigned int type)
+{
+    return _type_has_events(type);
+}
 
 /* --- queries ------------------------------------------------------------- */
 
@@ -619,6 +816,9 @@ void physics_init()
     /* init cpSpace */
     space = cpSpaceNew();
     cpSpaceSetGravity(space, cpv(0, -9.8));
+    cpSpaceSetSleepTimeThreshold(space, 0.5);
+    cpSpaceSetDefaultCollisionHandler(space, _begin, NULL, _post_solve,
+                                      _separate, NULL);
 
     /* init draw stuff */
     program = gfx_create_program(data_path("phypoly.vert"),
@@ -646,6 +846,9 @@ void physics_deinit()
 
     /* deinit cpSpace */
     cpSpaceFree(space);
+    free(events);
+    events = NULL;
+    nevents = events_capacity = 0;
 
     /* deinit pools, maps */
     entitymap_free(debug_draw_map);
@@ -654,16 +857,41 @@ void physics_deinit()
 
 /* --- update -------------------------------------------------------------- */
 
-/* step the space with fixed time step */
+/* save poses of moving bodies before a step */
+static void _save_prev()
+{
+    PhysicsInfo *info;
+
+    entitypool_foreach(info, pool)
+        if (info->type == PB_DYNAMIC && !cpBodyIsSleeping(info->body))
+        {
+            info->prev_pos = cpBodyGetPos(info->body);
+            info->prev_ang = cpBodyGetAngle(info->body);
+        }
+}
+
+/* step the space with fixed time step, at most max_steps times */
 static void _step()
 {
-    static Scalar remain = 0.0;
+    unsigned int i;
 
     remain += timing_dt;
-    while (remain >= period)
+    num_steps = remain / period;
+    remain -= num_steps * period;
+    if (remain < 0)
+        remain = 0;
+    if (num_steps > max_steps)
+    {
+        num_dropped_steps += num_steps - max_steps;
+        num_steps = max_steps;
+    }
+
+    for (i = 0; i < num_steps; ++i)
     {
+        /* interpolation blends from poses before the last step */
+        if (interpolation && i + 1 == num_steps)
+            _save_prev();
         cpSpaceStep(space, period);
-        remain -= period;
     }
 }
 
@@ -687,8 +915,8 @@ static void _update_kinematics()
             /* move to transform */
             pos = cpv_of_vec2(transform_get_position(ent));
             ang = transform_get_rotation(ent);
-            cpBodySetPos(info->body, pos);
-            cpBodySetAngle(info->body, ang);
+            if (!cpveql(pos, info->last_pos) || ang != info->last_ang)
+                _set_pos_ang(info, pos, ang);
             info->last_dirty_count = transform_get_dirty_count(ent);
 
             /* update linear, angular velocities based on delta */
@@ -706,39 +934,68 @@ void physics_update_all()
 {
     PhysicsInfo *info;
     Entity ent;
+    unsigned int dirty_count;
+    cpVect pos;
+    cpFloat ang, alpha;
 
     entitypool_remove_destroyed(pool, physics_remove);
 
     entitymap_clear(debug_draw_map);
 
     /* simulate */
+    num_steps = 0;
     if (!timing_get_paused())
     {
         _update_kinematics();
         _step();
     }
 
-    /* synchronize transform <-> physics */
+    /*
+     * synchronize transform <-> physics -- bodies that didn't move since
+     * last sync are left alone
+     */
+    alpha = interpolation ? remain / period : 1;
+    num_synced = num_sleeping = 0;
     entitypool_foreach(info, pool)
     {
         ent = info->pool_elem.ent;
 
         /* if transform is dirtier, move to it, else overwrite it */
-        if (transform_get_dirty_count(ent) != info->last_dirty_count)
+        dirty_count = transform_get_dirty_count(ent);
+        if (dirty_count != info->last_dirty_count)
         {
             cpBodySetVel(info->body, cpvzero);
             cpBodySetAngVel(info->body, 0.0f);
-            cpBodySetPos(info->body, cpv_of_vec2(transform_get_position(ent)));
-            cpBodySetAngle(info->body, transform_get_rotation(ent));
+            _set_pos_ang(info, cpv_of_vec2(transform_get_position(ent)),
+                         transform_get_rotation(ent));
             cpSpaceReindexShapesForBody(space, info->body);
+            info->last_dirty_count = dirty_count;
         }
         else if (info->type == PB_DYNAMIC)
         {
-            transform_set_position(ent, vec2_of_cpv(cpBodyGetPos(info->body)));
-            transform_set_rotation(ent, cpBodyGetAngle(info->body));
-        }
+            /*
+             * sleeping bodies aren't blended -- one that just fell asleep
+             * is left at its last blended pose, so it gets its real pose
+             * once, after that it matches and is skipped
+             */
+            pos = cpBodyGetPos(info->body);
+            ang = cpBodyGetAngle(info->body);
+            if (cpBodyIsSleeping(info->body))
+                ++num_sleeping;
+            else if (interpolation)
+            {
+                pos = cpvlerp(info->prev_pos, pos, alpha);
+                ang = info->prev_ang + (ang - info->prev_ang) * alpha;
+            }
+            if (cpveql(pos, info->sync_pos) && ang == info->sync_ang)
+                continue;
 
-        info->last_dirty_count = transform_get_dirty_count(ent);
+            transform_set_position_rotation(ent, vec2_of_cpv(pos), ang);
+            info->sync_pos = pos;
+            info->sync_ang = ang;
+            info->last_dirty_count = transform_get_dirty_count(ent);
+            ++num_synced;
+        }
     }
 }
 
@@ -746,15 +1003,17 @@ void physics_post_update_all()
 {
     PhysicsInfo *info;
 
+    /*
+     * scripts have seen this frame's events in post update, clear them --
+     * removals below end contacts too, so clear first to keep those
+     */
+    nevents = 0;
+
     entitypool_remove_destroyed(pool, physics_remove);
 
-    /* clear collisions */
+    /* clear collisions, memory is released with frame */
     entitypool_foreach(info, pool)
-        if (info->collisions)
-        {
-            array_free(info->collisions);
-            info->collisions = NULL;
-        }
+        info->collisions = NULL;
 }
 
 /* --- draw ---------------------------------------------------------------- */
@@ -806,7 +1065,7 @@ static void _polygon_draw(PhysicsInfo *info, ShapeInfo *shapeInfo)
 
     /* copy as Vec2 array */
     nverts = cpPolyShapeGetNumVerts(shapeInfo->shape);
-    verts = malloc(nverts * sizeof(Vec2));
+    verts = frame_alloc(nverts * sizeof(Vec2));
     for (i = 0; i < nverts; ++i)
         verts[i] = vec2_of_cpv(cpPolyShapeGetVert(shapeInfo->shape, i));
 
@@ -816,8 +1075,6 @@ static void _polygon_draw(PhysicsInfo *info, ShapeInfo *shapeInfo)
                  verts, GL_STREAM_DRAW);
     glDrawArrays(GL_LINE_LOOP, 0, nverts);
     glDrawArrays(GL_POINTS, 0, nverts);
-
-    free(verts);
 }
 
 void physics_draw_all()
@@ -947,8 +1204,8 @@ static void _body_load(PhysicsInfo *info, Store *s)
     _set_type(info, type);
 
     /* restore position, angle based on transform */
-    cpBodySetPos(info->body, cpv_of_vec2(transform_get_position(ent)));
-    cpBodySetAngle(info->body, transform_get_rotation(ent));
+    _set_pos_ang(info, cpv_of_vec2(transform_get_position(ent)),
+                 transform_get_rotation(ent));
     info->last_dirty_count = transform_get_dirty_count(info->pool_elem.ent);
 }
 
@@ -7,6 +7,7 @@
 #include "script_export.h"
 #include "scalar.h"
 #include "entity.h"
+#include "entitypool.h"
 #include "vec2.h"
 #include "bbox.h"
 
@@ -19,6 +20,35 @@ SCRIPT(physics,
        EXPORT void physics_set_simulation_frequency(Scalar freq);
        EXPORT Scalar physics_get_simulation_frequency();
 
+       /*
+        * bodies that stay slow for this many seconds fall asleep and are
+        * neither simulated nor synced to transform till woken by a touch,
+        * a force or a move -- SCALAR_INFINITY disables sleeping
+        */
+       EXPORT void physics_set_sleep_time(Scalar t);
+       EXPORT Scalar physics_get_sleep_time();
+
+       /*
+        * the simulation runs in fixed steps of 1 / simulation_frequency,
+        * at most max_steps per update with any time beyond that dropped
+        * -- with interpolation on, dynamic bodies' transforms are blended
+        * between the last two steps by the time left over, so lower
+        * frequencies still move smoothly at the cost of showing poses up
+        * to a step late
+        */
+       EXPORT void physics_set_interpolation(bool interpolation);
+       EXPORT bool physics_get_interpolation();
+       EXPORT void physics_set_max_steps(unsigned int max_steps);
+       EXPORT unsigned int physics_get_max_steps();
+
+       /* in last update, bodies whose transform was written, asleep */
+       EXPORT unsigned int physics_get_num_synced();
+       EXPORT unsigned int physics_get_num_sleeping();
+
+       /* steps in last update, total steps ever dropped by max_steps */
+       EXPORT unsigned int physics_get_num_steps();
+       EXPORT unsigned int physics_get_num_dropped_steps();
+
 
        /* add/remove body */
 
@@ -38,10 +68,14 @@ SCRIPT(physics,
        EXPORT void physics_add(Entity ent); /* PB_DYNAMIC by default */
        EXPORT void physics_remove(Entity ent);
        EXPORT bool physics_has(Entity ent);
+       EXPORT EntityPool *physics_get_pool(); /* for entitypool_join_*() */
 
        EXPORT void physics_set_type(Entity ent, PhysicsBody type);
        EXPORT PhysicsBody physics_get_type(Entity ent);
 
+       /* only PB_DYNAMIC bodies sleep */
+       EXPORT bool physics_get_sleeping(Entity ent);
+
        /* draws this object for one frame */
        EXPORT void physics_debug_draw(Entity ent);
 
@@ -89,6 +123,13 @@ SCRIPT(physics,
        EXPORT Vec2 physics_shape_get_surface_velocity(Entity ent,
                                                       unsigned int i);
 
+       /* 0 by default, see collision events below */
+       EXPORT void physics_shape_set_collision_type(Entity ent,
+                                                    unsigned int i,
+                                                    unsigned int type);
+       EXPORT unsigned int physics_shape_get_collision_type(Entity ent,
+                                                            unsigned int i);
+
        /* dynamics */
 
        EXPORT void physics_set_mass(Entity ent, Scalar mass);
@@ -130,6 +171,49 @@ SCRIPT(physics,
        EXPORT unsigned int physics_get_num_collisions(Entity ent);
        EXPORT Collision *physics_get_collisions(Entity ent);
 
+       /*
+        * collision events -- every contact that begins or ends is appended
+        * to one buffer, in order, so all of them can be handled in one
+        * pass instead of asking each entity
+        *
+        * the buffer is cleared at the end of each frame, after script
+        * post update, so it holds the events since the last clear -- read
+        * it in post update to see all of a frame's steps
+        *
+        * removing a body that's touching something (physics_remove(...) or
+        * destroying its entity) appends CE_END events, as does stepping,
+        * and appending may move the buffer -- get the pointer again after
+        * anything that could, don't keep it across frames
+        */
+
+       typedef enum CollisionEventType CollisionEventType;
+       enum CollisionEventType
+       {
+           CE_BEGIN = 0,
+           CE_END   = 1,
+       };
+
+       typedef struct CollisionEvent CollisionEvent;
+       struct CollisionEvent
+       {
+           CollisionEventType type;
+           Entity a, b;
+           Vec2 normal; /* from a to b, zero for CE_END */
+           Scalar impulse; /* of first contact, zero for sensors, CE_END */
+       };
+
+       EXPORT unsigned int physics_get_num_collision_events();
+       EXPORT CollisionEvent *physics_get_collision_events();
+
+       /*
+        * whether contacts involving a shape of collision type 'type' make
+        * events, true for all by default -- only types below 32 can have
+        * events
+        */
+       EXPORT void physics_set_collision_events(unsigned int type,
+                                                bool enabled);
+       EXPORT bool physics_get_collision_events_enabled(unsigned int type);
+
 
        /* nearest query */
 
@@ -134,7 +134,8 @@ static void _stream_write_string(Stream *sm, const char *s)
 /* store allocated length in plen if non-NULL */
 static char *_stream_read_string_(Stream *sm, size_t *plen)
 {
-    Stream rm[1];
+    size_t pos, len;
+    char *s;
 
     /* NULL? */
     if (sm->buf[sm->pos] == 'n')
@@ -145,35 +146,36 @@ static char *_stream_read_string_(Stream *sm, size_t *plen)
         return NULL;
     }
 
-    _stream_init(rm);
-
     /* opening quote */
     if (sm->buf[sm->pos] != '"')
         error("corrupt save");
     ++sm->pos;
 
-    while (sm->buf[sm->pos] != '"')
-    {
-        _stream_grow(rm, rm->pos);
+    /* find length first so we allocate just once */
+    for (pos = sm->pos, len = 0; sm->buf[pos] != '"'; ++len)
+        if (sm->buf[pos] == '\\' && sm->buf[pos + 1] == '"')
+            pos += 2;
+        else
+            ++pos;
+    s = malloc(len + 1);
 
-        /* escape quotes */
+    /* copy, unescaping quotes */
+    for (len = 0; sm->buf[sm->pos] != '"'; ++len)
         if (sm->buf[sm->pos] == '\\' && sm->buf[sm->pos + 1] == '"')
         {
-            rm->buf[rm->pos++] = '"';
+            s[len] = '"';
             sm->pos += 2;
         }
         else
-            rm->buf[rm->pos++] = sm->buf[sm->pos++];
-    }
+            s[len] = sm->buf[sm->pos++];
     sm->pos += 2; /* closing quote, space */
 
-    _stream_grow(rm, rm->pos);
-    rm->buf[rm->pos] = '\0';
+    s[len] = '\0';
 
     if (plen)
-        *plen = rm->cap;
+        *plen = len + 1;
 
-    return rm->buf;
+    return s;
 }
 #define _stream_read_string(sm) _stream_read_string_(sm, NULL)
 
@@ -0,0 +1,269 @@
+#include "soapool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "entitymap.h"
+#include "error.h"
+
+#define MIN_CAPACITY 16
+
+typedef struct Column Column;
+struct Column
+{
+    void *mem;               /* as returned by malloc(...) */
+    char *buf;               /* mem moved up to SOAPOOL_ALIGN boundary */
+    size_t object_size;
+};
+
+struct SoaPool
+{
+    EntityMap *emap;         /* Entity -> row, -1 if doesn't exist */
+
+    /* column 0 is the Entity per row */
+    Column cols[SOAPOOL_MAX_COLUMNS + 1];
+    unsigned int ncols;
+
+    unsigned int size;       /* number of rows */
+    unsigned int capacity;   /* number of rows we have space for */
+};
+
+/* allocate column buffer for capacity rows, keep first size rows */
+static void _column_realloc(Column *col, unsigned int size,
+                            unsigned int capacity)
+{
+    void *mem;
+    char *buf;
+
+    mem = malloc(capacity * col->object_size + SOAPOOL_ALIGN - 1);
+    buf = (char *) (((uintptr_t) mem + SOAPOOL_ALIGN - 1)
+                    & ~((uintptr_t) SOAPOOL_ALIGN - 1));
+    if (col->mem)
+    {
+        memcpy(buf, col->buf, size * col->object_size);
+        free(col->mem);
+    }
+    col->mem = mem;
+    col->buf = buf;
+}
+
+static void _resize(SoaPool *pool, unsigned int capacity)
+{
+    unsigned int i;
+
+    pool->capacity = capacity;
+    for (i = 0; i < pool->ncols; ++i)
+        _column_realloc(&pool->cols[i], pool->size, capacity);
+}
+
+SoaPool *soapool_new()
+{
+    SoaPool *pool = malloc(sizeof(SoaPool));
+
+    pool->emap = entitymap_new(-1);
+    pool->ncols = 0;
+    pool->size = 0;
+    pool->capacity = MIN_CAPACITY;
+
+    soapool_add_column(pool, Entity);
+
+    return pool;
+}
+void soapool_free(SoaPool *pool)
+{
+    unsigned int i;
+
+    for (i = 0; i < pool->ncols; ++i)
+        free(pool->cols[i].mem);
+    entitymap_free(pool->emap);
+    free(pool);
+}
+
+unsigned int soapool_add_column_(SoaPool *pool, size_t object_size)
+{
+    Column *col;
+
+    error_assert(pool->size == 0, "columns must be added before rows");
+    error_assert(pool->ncols <= SOAPOOL_MAX_COLUMNS, "too many columns");
+
+    col = &pool->cols[pool->ncols];
+    col->mem = NULL;
+    col->object_size = object_size;
+    _column_realloc(col, 0, pool->capacity);
+    return pool->ncols++;
+}
+
+unsigned int soapool_add(SoaPool *pool, Entity ent)
+{
+    int row;
+
+    if ((row = soapool_get(pool, ent)) >= 0)
+        return row;
+
+    /* stale row from an older generation of this index? drop it */
+    row = entitymap_get(pool->emap, ent);
+    if (row >= 0)
+        soapool_remove(pool, soapool_entities(pool)[row]);
+
+    /* too small? double it */
+    if (pool->size == pool->capacity)
+        _resize(pool, pool->capacity << 1);
+
+    /* add row and set it in map */
+    row = pool->size++;
+    soapool_entities(pool)[row] = ent;
+    entitymap_set(pool->emap, ent, row);
+    return row;
+}
+void soapool_remove(SoaPool *pool, Entity ent)
+{
+    int row;
+    unsigned int i, last;
+    Column *col;
+    Entity *ents;
+
+    row = entitymap_get(pool->emap, ent);
+    if (row < 0)
+        return;
+
+    /* ignore if mapped row is of another generation */
+    ents = soapool_entities(pool);
+    if (!entity_eq(ents[row], ent))
+        return;
+
+    /* move last row into this one and fix its mapping */
+    last = pool->size - 1;
+    if ((unsigned int) row != last)
+    {
+        for (i = 0; i < pool->ncols; ++i)
+        {
+            col = &pool->cols[i];
+            memcpy(col->buf + row * col->object_size,
+                   col->buf + last * col->object_size, col->object_size);
+        }
+        entitymap_set(pool->emap, ents[row], row);
+    }
+    --pool->size;
+
+    /* remove mapping */
+    entitymap_set(pool->emap, ent, -1);
+
+    /* too big (> four times as is needed)? halve it */
+    if (pool->size << 2 < pool->capacity && pool->capacity > MIN_CAPACITY)
+        _resize(pool, pool->capacity >> 1);
+}
+int soapool_get(SoaPool *pool, Entity ent)
+{
+    int row;
+
+    /* index may be mapped for another generation */
+    row = entitymap_get(pool->emap, ent);
+    if (row >= 0 && entity_eq(soapool_entities(pool)[row], ent))
+        return row;
+    return -1;
+}
+
+unsigned int soapool_size(SoaPool *pool)
+{
+    return pool->size;
+}
+
+void *soapool_column(SoaPool *pool, unsigned int col)
+{
+    return pool->cols[col].buf;
+}
+Entity *soapool_entities(SoaPool *pool)
+{
+    return (Entity *) pool->cols[0].buf;
+}
+
+void soapool_clear(SoaPool *pool)
+{
+    entitymap_clear(pool->emap);
+    pool->size = 0;
+    _resize(pool, MIN_CAPACITY);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef SOAPOOL_TEST
+
+#include <stdio.h>
+
+static SoaPool *pool;
+static unsigned int x_col, name_col;
+
+void dump()
+{
+    unsigned int row;
+    Entity *ents = soapool_entities(pool);
+
+    printf("{ ");
+    for (row = 0; row < soapool_size(pool); ++row)
+        printf("(%u: %d %c) ", ents[row].id,
+               soapool_get_val(int, pool, x_col, row),
+               soapool_get_val(char, pool, name_col, row));
+    printf("}\n");
+}
+
+int main()
+{
+    unsigned int i, row;
+    Entity ents[40];
+
+    entity_init();
+
+    pool = soapool_new();
+    x_col = soapool_add_column(pool, int);
+    name_col = soapool_add_column(pool, char);
+
+    for (i = 0; i < 5; ++i)
+    {
+        ents[i] = entity_create();
+        row = soapool_add(pool, ents[i]);
+        soapool_get_val(int, pool, x_col, row) = i * 10;
+        soapool_get_val(char, pool, name_col, row) = 'a' + i;
+    }
+    dump();
+
+    /* last row moves into removed one, with all its columns */
+    soapool_remove(pool, ents[1]);
+    dump();
+    printf("row of %u: %d, of %u: %d\n", ents[4].id,
+           soapool_get(pool, ents[4]), ents[1].id,
+           soapool_get(pool, ents[1]));
+
+    /* adding again doesn't duplicate */
+    printf("add existing: row %u, size %u\n", soapool_add(pool, ents[2]),
+           soapool_size(pool));
+
+    /* grow past MIN_CAPACITY, columns must stay aligned and keep data */
+    for (i = 5; i < 40; ++i)
+    {
+        ents[i] = entity_create();
+        row = soapool_add(pool, ents[i]);
+        soapool_get_val(int, pool, x_col, row) = i * 10;
+        soapool_get_val(char, pool, name_col, row) = 'a' + i % 26;
+    }
+    printf("size %u, aligned %d, row of %u has %d\n", soapool_size(pool),
+           ((size_t) soapool_column(pool, x_col) % SOAPOOL_ALIGN) == 0
+           && ((size_t) soapool_column(pool, name_col) % SOAPOOL_ALIGN) == 0,
+           ents[3].id, soapool_get_val(int, pool, x_col,
+                                       soapool_get(pool, ents[3])));
+
+    /* shrink back down */
+    for (i = 5; i < 40; ++i)
+        soapool_remove(pool, ents[i]);
+    dump();
+
+    soapool_clear(pool);
+    dump();
+
+    soapool_free(pool);
+    entity_deinit();
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SOAPOOL_H
+#define SOAPOOL_H
+
+#include <stddef.h>
+
+#include "entity.h"
+
+/*
+ * like EntityPool but stores each field of the element in its own array
+ * ('column') -- useful when a pass only reads a few fields of many
+ * elements, since it then only touches the memory of those fields
+ *
+ * set up the columns right after soapool_new(...):
+ *
+ *     pool = soapool_new();
+ *     pos_col = soapool_add_column(pool, Vec2);
+ *     depth_col = soapool_add_column(pool, int);
+ *
+ * and then use rows like EntityPool elements:
+ *
+ *     row = soapool_add(pool, ent);
+ *     soapool_get_val(Vec2, pool, pos_col, row) = vec2(1, 2);
+ *
+ * adding/removing keeps rows contiguous by moving the last row into the
+ * removed one, just as with EntityPool, so row numbers and column pointers
+ * change on add/remove
+ *
+ * each column starts at a SOAPOOL_ALIGN-byte boundary and has space for a
+ * power-of-2 number (at least 16) of rows, so SIMD loops can safely run
+ * past the last row up to a multiple of 4 rows
+ */
+
+#define SOAPOOL_ALIGN 32
+#define SOAPOOL_MAX_COLUMNS 16
+
+typedef struct SoaPool SoaPool;
+
+SoaPool *soapool_new();
+void soapool_free(SoaPool *pool);
+
+/* returns column number, must be called before any rows are added */
+unsigned int soapool_add_column_(SoaPool *pool, size_t object_size);
+#define soapool_add_column(pool, type) soapool_add_column_(pool, sizeof(type))
+
+/* data in new row is undefined, returns existing row if already mapped */
+unsigned int soapool_add(SoaPool *pool, Entity ent);
+void soapool_remove(SoaPool *pool, Entity ent);
+int soapool_get(SoaPool *pool, Entity ent); /* row, -1 if not mapped */
+
+unsigned int soapool_size(SoaPool *pool); /* number of rows */
+
+/* pointer to first row of column -- invalidated by add/remove */
+void *soapool_column(SoaPool *pool, unsigned int col);
+#define soapool_get_val(type, pool, col, row)           \
+    (((type *) soapool_column(pool, col))[row])
+Entity *soapool_entities(SoaPool *pool); /* Entity per row */
+
+void soapool_clear(SoaPool *pool);
+
+/* same as entitypool_remove_destroyed(...) */
+#define soapool_remove_destroyed(pool, func)                    \
+    do                                                          \
+    {                                                           \
+        unsigned int __i;                                       \
+        Entity __ent;                                           \
+        for (__i = 0; __i < entity_get_num_destroyed(); ++__i)  \
+        {                                                       \
+            __ent = entity_get_nth_destroyed(__i);              \
+            if (soapool_get(pool, __ent) >= 0)                  \
+                func(__ent);                                    \
+        }                                                       \
+    } while (0)
+
+#endif
+
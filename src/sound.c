@@ -7,7 +7,7 @@
 
 #include "dirs.h"
 #include "input.h"
-#include "entitypool.h"
+#include "chunkpool.h"
 #include "array.h"
 #include "error.h"
 
@@ -23,7 +23,11 @@ struct Sound
     bool loop;
 };
 
-static EntityPool *pool;
+/*
+ * a ChunkPool so Sound pointers stay valid -- they're given to gorilla as
+ * the finish callback context
+ */
+static ChunkPool *pool;
 
 static gau_Manager *mgr;
 static ga_Mixer *mixer;
@@ -64,6 +68,15 @@ static void _update_loop(Sound *sound)
         gau_sample_source_loop_clear(sound->loop_src);
 }
 
+/* finish callback, destroys sounds that have finish_destroy set */
+static void _finished(ga_Handle *handle, void *context)
+{
+    Sound *sound = context;
+
+    if (sound->finish_destroy)
+        entity_destroy(sound->pool_elem.ent);
+}
+
 /* precondition: path must be good or NULL, handle must be good or NULL,
    doesn't allocate new path string if sound->path == path */
 static void _set_path(Sound *sound, const char *path)
@@ -82,10 +95,11 @@ static void _set_path(Sound *sound, const char *path)
     handle = NULL;
     if (!strcmp(format, "ogg"))
         handle = gau_create_handle_buffered_file(mixer, stream_mgr, path,
-                                                 format, NULL, NULL,
+                                                 format, _finished, sound,
                                                  &loop_src);
     else if ((src = gau_load_sound_file(path, format)))
-        handle = gau_create_handle_sound(mixer, src, NULL, NULL, &loop_src);
+        handle = gau_create_handle_sound(mixer, src, _finished, sound,
+                                         &loop_src);
     if (!handle)
         error("couldn't load sound from path '%s', check path and format",
               path);
@@ -113,10 +127,10 @@ void sound_add(Entity ent)
 {
     Sound *sound;
 
-    if (entitypool_get(pool, ent))
+    if (chunkpool_get(pool, ent))
         return;
 
-    sound = entitypool_add(pool, ent);
+    sound = chunkpool_add(pool, ent);
     sound->path = NULL;
     sound->handle = NULL;
     sound->loop_src = NULL;
@@ -130,37 +144,37 @@ void sound_remove(Entity ent)
 {
     Sound *sound;
 
-    sound = entitypool_get(pool, ent);
+    sound = chunkpool_get(pool, ent);
     if (!sound)
         return;
 
     _release(sound);
-    entitypool_remove(pool, ent);
+    chunkpool_remove(pool, ent);
 }
 
 bool sound_has(Entity ent)
 {
-    return entitypool_get(pool, ent) != NULL;
+    return chunkpool_get(pool, ent) != NULL;
 }
 
 void sound_set_path(Entity ent, const char *path)
 {
     Sound *sound;
 
-    sound =  entitypool_get(pool, ent);
+    sound =  chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     _set_path(sound, path);
 }
 const char *sound_get_path(Entity ent)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     return sound->path;
 }
 
 void sound_set_playing(Entity ent, bool playing)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     if (playing)
@@ -174,7 +188,7 @@ void sound_set_playing(Entity ent, bool playing)
 }
 bool sound_get_playing(Entity ent)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     return ga_handle_playing(sound->handle);
@@ -182,14 +196,14 @@ bool sound_get_playing(Entity ent)
 
 void sound_set_seek(Entity ent, int seek)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     ga_handle_seek(sound->handle, seek);
 }
 int sound_get_seek(Entity ent)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     return ga_handle_tell(sound->handle, GA_TELL_PARAM_CURRENT);
@@ -197,20 +211,24 @@ int sound_get_seek(Entity ent)
 
 void sound_set_finish_destroy(Entity ent, bool finish_destroy)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     sound->finish_destroy = finish_destroy;
+
+    /* already finished? _finished(...) won't be called again */
+    if (finish_destroy && sound->handle && ga_handle_finished(sound->handle))
+        entity_destroy(ent);
 }
 bool sound_get_finish_destroy(Entity ent)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     return sound->finish_destroy;
 }
 
 void sound_set_loop(Entity ent, bool loop)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     sound->loop = loop;
@@ -218,14 +236,14 @@ void sound_set_loop(Entity ent, bool loop)
 }
 bool sound_get_loop(Entity ent)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     return sound->loop;
 }
 
 void sound_set_gain(Entity ent, Scalar gain)
 {
-    Sound *sound = entitypool_get(pool, ent);
+    Sound *sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     ga_handle_setParamf(sound->handle, GA_HANDLE_PARAM_GAIN, gain);
@@ -235,7 +253,7 @@ Scalar sound_get_gain(Entity ent)
     Sound *sound;
     gc_float32 v;
 
-    sound = entitypool_get(pool, ent);
+    sound = chunkpool_get(pool, ent);
     error_assert(sound, "entity must be in sound system");
     error_assert(sound->handle, "sound must be valid");
     ga_handle_getParamf(sound->handle, GA_HANDLE_PARAM_GAIN, &v);
@@ -251,15 +269,15 @@ void sound_init()
     mixer = gau_manager_mixer(mgr);
     stream_mgr = gau_manager_streamManager(mgr);
 
-    pool = entitypool_new(Sound);
+    pool = chunkpool_new(Sound);
 }
 void sound_deinit()
 {
     Sound *sound;
 
-    entitypool_foreach(sound, pool)
+    chunkpool_foreach(sound, pool)
         _release(sound);
-    entitypool_free(pool);
+    chunkpool_free(pool);
 
     gau_manager_destroy(mgr);
     gc_shutdown();
@@ -267,16 +285,9 @@ void sound_deinit()
 
 void sound_update_all()
 {
-    Sound *sound;
-
-    /* destroy finished sounds that have finish_destroy set */
-    entitypool_foreach(sound, pool)
-        if (sound->finish_destroy
-            && sound->handle && ga_handle_finished(sound->handle))
-            entity_destroy(sound->pool_elem.ent);
-
-    entitypool_remove_destroyed(pool, sound_remove);
+    chunkpool_remove_destroyed(pool, sound_remove);
 
+    /* calls _finished(...) for sounds that finished */
     gau_manager_update(mgr);
 }
 
@@ -289,7 +300,7 @@ void sound_save_all(Store *s)
     Scalar gain;
 
     if (store_child_save(&t, "sound", s))
-        entitypool_save_foreach(sound, sound_s, pool, "pool", t)
+        chunkpool_save_foreach(sound, sound_s, pool, "pool", t)
         {
             string_save((const char **) &sound->path, "path", sound_s);
             bool_save(&sound->finish_destroy, "finish_destroy", sound_s);
@@ -315,7 +326,7 @@ void sound_load_all(Store *s)
     Scalar gain;
 
     if (store_child_load(&t, "sound", s))
-        entitypool_load_foreach(sound, sound_s, pool, "pool", t)
+        chunkpool_load_foreach(sound, sound_s, pool, "pool", t)
         {
             string_load(&path, "path", NULL, sound_s);
             bool_load(&sound->finish_destroy, "finish_destroy", false, sound_s);
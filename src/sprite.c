@@ -2,7 +2,7 @@
 
 #include <string.h>
 #include <stdlib.h>
-#include <GL/glew.h>
+#include "glew_glfw.h"
 
 #include "error.h"
 #include "entitypool.h"
@@ -14,53 +14,162 @@
 #include "camera.h"
 #include "texture.h"
 #include "edit.h"
+#include "array.h"
+#include "frame.h"
 
 typedef struct Sprite Sprite;
 struct Sprite
 {
     EntityPoolElem pool_elem;
 
-    Mat3 wmat; /* world transform matrix to send to shader */
+    Affine wmat; /* world transform matrix to send to shader */
 
     Vec2 size;
     Vec2 texcell;
     Vec2 texsize;
 
     int depth;
+    unsigned int atlas; /* index into atlases */
+
+    bool is_static; /* in static_pool instead of pool */
+    unsigned int dirty_count; /* world dirty count when static built */
 };
 
+/*
+ * static sprites are kept apart so the per-frame work (matrix fetch,
+ * culling, upload) skips them -- their layer is rebuilt only when one of
+ * them changes
+ */
 static EntityPool *pool;
+static EntityPool *static_pool;
+static bool static_dirty = false;
+
+/*
+ * filenames of atlases in use -- atlases[0] is the default atlas set with
+ * sprite_set_atlas(...), the rest are added as sprites ask for them and
+ * kept till sprite_deinit()
+ */
+static Array *atlases;
+#define _atlas_name(i) array_get_val(char *, atlases, i)
+
+/* per-instance data the shader reads, packed */
+typedef struct SpriteInstance SpriteInstance;
+struct SpriteInstance
+{
+    Affine wmat;
+    Vec2 size;
+    Vec2 texcell;
+    Vec2 texsize;
+};
+
+/*
+ * a run of instances in draw order with the same atlas -- may span depths,
+ * drawing splits it where the other layer's batches must go in between
+ */
+typedef struct Batch Batch;
+struct Batch
+{
+    unsigned int atlas;
+    unsigned int first, count;
+};
+
+/* a run of instances [first, end) at least partly in view */
+typedef struct Range Range;
+struct Range
+{
+    unsigned int first, end;
+};
+
+/*
+ * the dynamic layer draws from a ring of this many vbos, writing each
+ * frame to the one drawn longest ago -- the GPU is done reading it by
+ * then, so updating it doesn't have to wait
+ */
+#define NUM_BUFFERS 3
+
+/*
+ * instances in draw order, mirrored in instances so that only instances
+ * that changed need be uploaded -- each vbo of the ring remembers the
+ * frame it was last brought up to date and gets the instances changed
+ * since
+ *
+ * each sprite keeps the slot of its pool index whether in view or not, so
+ * sprites going in or out of view don't shift the others -- culling only
+ * clips batches to the visible ranges when drawing
+ */
+typedef struct Layer Layer;
+struct Layer
+{
+    GLuint vaos[NUM_BUFFERS];
+    GLuint vbos[NUM_BUFFERS];
+    unsigned int stores[NUM_BUFFERS]; /* capacity of each vbo's store */
+    unsigned int synced[NUM_BUFFERS]; /* frame each vbo was updated */
+    unsigned int nbuffers; /* size of ring, 1 for the static layer */
+    unsigned int curr; /* vbo drawn from this frame */
+    unsigned int frame; /* counts updates, from 1 */
+
+    SpriteInstance *instances;
+    unsigned int *changed; /* frame each instance last changed */
+    unsigned int ninstances; /* number valid */
+    unsigned int capacity; /* size of instances, changed */
+
+    Batch *batches; /* made while packing instances, at most one each */
+    unsigned int nbatches;
+
+    bool culled; /* whether to draw only visible */
+    Range *visible; /* in order, at most one per instance */
+    unsigned int nvisible;
+};
+
+static Layer dynamic_layer; /* culled, updated every frame */
+static Layer static_layer; /* not culled, rebuilt if static_dirty */
+
+static unsigned int bytes_uploaded = 0; /* by last sprite_draw_all() */
+
+#define MIN_CAPACITY 64
 
-static char *atlas = NULL;
+/*
+ * changed instances at most this far apart are uploaded together with the
+ * ones between, to save on calls
+ */
+#define MAX_UPLOAD_GAP 16
+
+/*
+ * visible ranges at most this far apart are drawn as one, drawing a few
+ * sprites out of view is cheaper than another call
+ */
+#define MAX_DRAW_GAP 16
 
 /* GL stuff */
 static GLuint program;
-static GLuint vao;
-static GLuint vbo;
 
 /* ------------------------------------------------------------------------- */
 
-/* copy string from filename, err is whether to error(...) if bad */
-static void _set_atlas(const char *filename, bool err)
+bool sprite_load_atlas(const char *filename, bool err)
 {
-    Vec2 atlas_size;
+    if (texture_load(filename))
+        return true;
+    if (err)
+        error("couldn't load atlas from path '%s', check path and format",
+              filename);
+    return false;
+}
 
-    if (!texture_load(filename))
-    {
-        if (err)
-            error("couldn't load atlas from path '%s', check path and format",
-                  filename);
-        return;
-    }
+/* copy string from filename into slot i */
+static void _set_atlas_name(unsigned int i, const char *filename)
+{
+    char *name;
 
-    free(atlas);
-    atlas = malloc(strlen(filename) + 1);
-    strcpy(atlas, filename);
+    name = malloc(strlen(filename) + 1);
+    strcpy(name, filename);
+    free(_atlas_name(i)); /* after copy, filename might be this */
+    _atlas_name(i) = name;
+}
 
-    atlas_size = texture_get_size(atlas);
-    glUseProgram(program);
-    glUniform2fv(glGetUniformLocation(program, "atlas_size"), 1,
-                 (const GLfloat *) &atlas_size);
+static void _set_atlas(const char *filename, bool err)
+{
+    if (sprite_load_atlas(filename, err))
+        _set_atlas_name(0, filename);
 }
 void sprite_set_atlas(const char *filename)
 {
@@ -68,90 +177,269 @@ void sprite_set_atlas(const char *filename)
 }
 const char *sprite_get_atlas()
 {
-    return atlas;
+    return _atlas_name(0);
 }
 
-void sprite_add(Entity ent)
+/*
+ * index of non-default atlas with given filename, added if new -- returns
+ * 0 (default) for NULL filename or if couldn't load
+ */
+static unsigned int _atlas_index(const char *filename, bool err)
+{
+    unsigned int i;
+
+    if (!filename)
+        return 0;
+
+    for (i = 1; i < array_length(atlases); ++i)
+        if (!strcmp(_atlas_name(i), filename))
+            return i;
+
+    if (!sprite_load_atlas(filename, err))
+        return 0;
+    array_add_val(char *, atlases) = NULL;
+    _set_atlas_name(i, filename);
+    return i;
+}
+
+static Sprite *_get(Entity ent)
+{
+    Sprite *sprite = entitypool_get(pool, ent);
+    return sprite ? sprite : entitypool_get(static_pool, ent);
+}
+static EntityPool *_pool_of(Sprite *sprite)
+{
+    return sprite->is_static ? static_pool : pool;
+}
+
+/* call after changing sprite, to rebuild static layer if needed */
+static void _changed(Sprite *sprite)
+{
+    if (sprite->is_static)
+        static_dirty = true;
+}
+
+static void _add(Entity ent, Vec2 size, Vec2 texcell, Vec2 texsize,
+                 int depth)
 {
     Sprite *sprite;
 
-    if (entitypool_get(pool, ent))
+    if (_get(ent))
         return; /* already has a sprite */
 
     transform_add(ent);
 
     sprite = entitypool_add(pool, ent);
-    sprite->size = vec2(1.0f, 1.0f);
-    sprite->texcell = vec2(32.0f, 32.0f);
-    sprite->texsize = vec2(32.0f, 32.0f);
-    sprite->depth = 0;
+    sprite->size = size;
+    sprite->texcell = texcell;
+    sprite->texsize = texsize;
+    sprite->depth = depth;
+    sprite->atlas = 0;
+    sprite->is_static = false;
+}
+void sprite_add(Entity ent)
+{
+    _add(ent, vec2(1.0f, 1.0f), vec2(32.0f, 32.0f), vec2(32.0f, 32.0f), 0);
+}
+void sprite_add_n(unsigned int n, const Entity *ents, const Vec2 *sizes,
+                  const Vec2 *texcells, const Vec2 *texsizes,
+                  const int *depths)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; ++i)
+        _add(ents[i],
+             sizes ? sizes[i] : vec2(1.0f, 1.0f),
+             texcells ? texcells[i] : vec2(32.0f, 32.0f),
+             texsizes ? texsizes[i] : vec2(32.0f, 32.0f),
+             depths ? depths[i] : 0);
 }
 void sprite_remove(Entity ent)
 {
-    entitypool_remove(pool, ent);
+    Sprite *sprite = _get(ent);
+
+    if (sprite)
+    {
+        _changed(sprite);
+        entitypool_remove(_pool_of(sprite), ent);
+    }
 }
 bool sprite_has(Entity ent)
 {
-    return entitypool_get(pool, ent) != NULL;
+    return _get(ent) != NULL;
+}
+EntityPool *sprite_get_pool()
+{
+    return pool;
 }
 
 void sprite_set_size(Entity ent, Vec2 size)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     sprite->size = size;
+    _changed(sprite);
 }
 Vec2 sprite_get_size(Entity ent)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     return sprite->size;
 }
 
 void sprite_set_texcell(Entity ent, Vec2 texcell)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     sprite->texcell = texcell;
+    _changed(sprite);
 }
 Vec2 sprite_get_texcell(Entity ent)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     return sprite->texcell;
 }
 void sprite_set_texsize(Entity ent, Vec2 texsize)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     sprite->texsize = texsize;
+    _changed(sprite);
 }
 Vec2 sprite_get_texsize(Entity ent)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     return sprite->texsize;
 }
 
 void sprite_set_depth(Entity ent, int depth)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
-    sprite->depth = depth;
+    if (sprite->depth != depth)
+    {
+        sprite->depth = depth;
+        entitypool_mark_unsorted(_pool_of(sprite));
+        _changed(sprite);
+    }
 }
 int sprite_get_depth(Entity ent)
 {
-    Sprite *sprite = entitypool_get(pool, ent);
+    Sprite *sprite = _get(ent);
     error_assert(sprite);
     return sprite->depth;
 }
 
+void sprite_set_entity_atlas(Entity ent, const char *filename)
+{
+    Sprite *sprite = _get(ent);
+    unsigned int atlas;
+
+    error_assert(sprite);
+    atlas = _atlas_index(filename, true);
+    if (sprite->atlas != atlas)
+    {
+        sprite->atlas = atlas;
+        entitypool_mark_unsorted(_pool_of(sprite)); /* batches by atlas */
+        _changed(sprite);
+    }
+}
+const char *sprite_get_entity_atlas(Entity ent)
+{
+    Sprite *sprite = _get(ent);
+    error_assert(sprite);
+    return _atlas_name(sprite->atlas);
+}
+
+void sprite_set_static(Entity ent, bool is_static)
+{
+    Sprite *sprite = _get(ent), tmp;
+
+    error_assert(sprite);
+    if (sprite->is_static == is_static)
+        return;
+
+    /* move to other pool */
+    static_dirty = true;
+    tmp = *sprite;
+    entitypool_remove(_pool_of(sprite), ent);
+    tmp.is_static = is_static;
+    if (!is_static)
+        tmp.wmat = mat3_to_affine(transform_get_world_matrix(ent));
+    sprite = entitypool_add(_pool_of(&tmp), ent);
+    *sprite = tmp;
+}
+bool sprite_get_static(Entity ent)
+{
+    Sprite *sprite = _get(ent);
+    error_assert(sprite);
+    return sprite->is_static;
+}
+
+unsigned int sprite_get_bytes_uploaded()
+{
+    return bytes_uploaded;
+}
+
 /* ------------------------------------------------------------------------- */
 
+static void _layer_init(Layer *layer, unsigned int nbuffers, bool culled)
+{
+    unsigned int i;
+
+    layer->instances = NULL;
+    layer->changed = NULL;
+    layer->batches = NULL;
+    layer->visible = NULL;
+    layer->nvisible = 0;
+    layer->ninstances = layer->capacity = layer->nbatches = 0;
+    layer->nbuffers = nbuffers;
+    layer->culled = culled;
+    layer->curr = 0;
+    layer->frame = 0;
+
+    /* make vaos, vbos, bind attributes */
+    glGenVertexArrays(nbuffers, layer->vaos);
+    glGenBuffers(nbuffers, layer->vbos);
+    for (i = 0; i < nbuffers; ++i)
+    {
+        layer->stores[i] = layer->synced[i] = 0;
+
+        glBindVertexArray(layer->vaos[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, layer->vbos[i]);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat1",
+                               SpriteInstance, wmat.m[0]);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat2",
+                               SpriteInstance, wmat.m[1]);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "wmat3",
+                               SpriteInstance, wmat.m[2]);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "size",
+                               SpriteInstance, size);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texcell",
+                               SpriteInstance, texcell);
+        gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texsize",
+                               SpriteInstance, texsize);
+    }
+}
+static void _layer_deinit(Layer *layer)
+{
+    glDeleteBuffers(layer->nbuffers, layer->vbos);
+    glDeleteVertexArrays(layer->nbuffers, layer->vaos);
+    free(layer->visible);
+    free(layer->batches);
+    free(layer->changed);
+    free(layer->instances);
+}
+
 void sprite_init()
 {
-    /* initialize pool */
+    /* initialize pools, atlas list with empty default slot */
     pool = entitypool_new(Sprite);
+    static_pool = entitypool_new(Sprite);
+    atlases = array_new(char *);
+    array_add_val(char *, atlases) = NULL;
 
     /* create shader program, load atlas */
     program = gfx_create_program(data_path("sprite.vert"),
@@ -161,67 +449,357 @@ void sprite_init()
     glUniform1i(glGetUniformLocation(program, "tex0"), 0);
     sprite_set_atlas(data_path("default.png"));
 
-    /* make vao, vbo, bind attributes */
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 3, "wmat1", Sprite, wmat.m[0]);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 3, "wmat2", Sprite, wmat.m[1]);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 3, "wmat3", Sprite, wmat.m[2]);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "size", Sprite, size);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texcell", Sprite, texcell);
-    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texsize", Sprite, texsize);
+    _layer_init(&dynamic_layer, NUM_BUFFERS, true);
+    _layer_init(&static_layer, 1, false);
+    static_dirty = false;
 }
 
 void sprite_deinit()
 {
+    char **name;
+
     /* clean up GL stuff */
     glDeleteProgram(program);
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
+    _layer_deinit(&static_layer);
+    _layer_deinit(&dynamic_layer);
 
-    /* deinit pool */
+    /* deinit pools */
+    entitypool_free(static_pool);
     entitypool_free(pool);
 
-    free(atlas);
+    array_foreach(name, atlases)
+        free(*name);
+    array_free(atlases);
 }
 
 void sprite_update_all()
 {
     Sprite *sprite;
+    EntityPool *pools[2];
+    EntityPoolJoin join;
     static Vec2 min = { -0.5, -0.5 }, max = { 0.5, 0.5 };
 
     entitypool_remove_destroyed(pool, sprite_remove);
+    entitypool_remove_destroyed(static_pool, sprite_remove);
+
+    /*
+     * update world transform matrices -- sprites of equal depth and atlas
+     * are in Entity order, as are root transforms added in that order, so
+     * the join mostly reads the transform pool sequentially
+     */
+    pools[0] = pool;
+    pools[1] = transform_get_pool();
+    entitypool_join_begin(&join, pools, 2);
+    while (entitypool_join_next(&join))
+    {
+        sprite = join.elems[0];
+        sprite->wmat = mat3_to_affine(
+            transform_elem_get_world_matrix(join.elems[1]));
+    }
 
-    /* update world transform matrices */
-    entitypool_foreach(sprite, pool)
-        sprite->wmat = transform_get_world_matrix(sprite->pool_elem.ent);
+    /* static sprites only need checking for moves */
+    if (!static_dirty)
+        entitypool_foreach(sprite, static_pool)
+            if (transform_get_world_dirty_count(sprite->pool_elem.ent)
+                != sprite->dirty_count)
+            {
+                static_dirty = true;
+                break;
+            }
 
     /* update edit bbox */
     if (edit_get_enabled())
+    {
         entitypool_foreach(sprite, pool)
             edit_bboxes_update(sprite->pool_elem.ent,
                                bbox(vec2_mul(sprite->size, min),
                                     vec2_mul(sprite->size, max)));
+        entitypool_foreach(sprite, static_pool)
+            edit_bboxes_update(sprite->pool_elem.ent,
+                               bbox(vec2_mul(sprite->size, min),
+                                    vec2_mul(sprite->size, max)));
+    }
 }
 
 static int _depth_compare(const void *a, const void *b)
 {
     const Sprite *sa = a, *sb = b;
 
-    /* descending, break ties by Entity id for stability */
-    if (sb->depth == sa->depth)
-        return ((int) sa->pool_elem.ent.id) - ((int) sb->pool_elem.ent.id);
-    return sb->depth - sa->depth;
+    /*
+     * descending, group equal depths by atlas so they batch, break
+     * remaining ties by Entity index for stability
+     */
+    if (sb->depth != sa->depth)
+        return sb->depth - sa->depth;
+    if (sa->atlas != sb->atlas)
+        return sa->atlas < sb->atlas ? -1 : 1;
+    return ((int) entity_index(sa->pool_elem.ent))
+        - ((int) entity_index(sb->pool_elem.ent));
+}
+
+/* make room for n instances */
+static void _layer_reserve(Layer *layer, unsigned int n)
+{
+    if (n <= layer->capacity)
+        return;
+
+    if (layer->capacity < MIN_CAPACITY)
+        layer->capacity = MIN_CAPACITY;
+    while (layer->capacity < n)
+        layer->capacity <<= 1;
+    layer->instances = realloc(layer->instances,
+                               layer->capacity * sizeof(SpriteInstance));
+    layer->changed = realloc(layer->changed,
+                             layer->capacity * sizeof(unsigned int));
+    layer->batches = realloc(layer->batches,
+                             layer->capacity * sizeof(Batch));
+    layer->visible = realloc(layer->visible,
+                             layer->capacity * sizeof(Range));
+}
+
+/* put sprite in batches as instance i, instances must be in draw order */
+static void _layer_batch(Layer *layer, Sprite *sprite, unsigned int i)
+{
+    Batch *batch;
+
+    batch = layer->nbatches > 0 ? &layer->batches[layer->nbatches - 1] : NULL;
+    if (!batch || batch->atlas != sprite->atlas)
+    {
+        batch = &layer->batches[layer->nbatches++];
+        batch->atlas = sprite->atlas;
+        batch->first = i;
+        batch->count = 0;
+    }
+    ++batch->count;
+}
+
+static void _instance(SpriteInstance *inst, Sprite *sprite)
+{
+    inst->wmat = sprite->wmat;
+    inst->size = sprite->size;
+    inst->texcell = sprite->texcell;
+    inst->texsize = sprite->texsize;
+}
+
+static void _upload(Layer *layer, unsigned int begin, unsigned int end)
+{
+    glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(SpriteInstance),
+                    (end - begin) * sizeof(SpriteInstance),
+                    layer->instances + begin);
+    bytes_uploaded += (end - begin) * sizeof(SpriteInstance);
+}
+
+/*
+ * pack all dynamic sprites, noting which instances changed and which
+ * ranges are in view
+ */
+static void _dynamic_pack()
+{
+    Layer *layer = &dynamic_layer;
+    Sprite *sprite;
+    SpriteInstance inst;
+    Range *range;
+    unsigned int i, n;
+    static Vec2 min = { -0.5, -0.5 }, max = { 0.5, 0.5 };
+
+    n = entitypool_size(pool);
+    _layer_reserve(layer, n);
+
+    i = 0;
+    layer->nbatches = 0;
+    layer->nvisible = 0;
+    entitypool_foreach(sprite, pool)
+    {
+        _layer_batch(layer, sprite, i);
+        _instance(&inst, sprite);
+        if (i >= layer->ninstances
+            || memcmp(&inst, &layer->instances[i], sizeof(SpriteInstance)))
+        {
+            layer->instances[i] = inst;
+            layer->changed[i] = layer->frame;
+        }
+
+        /* in view? extend last range if close enough, else start new */
+        if (camera_in_view(bbox_transform(mat3_from_affine(sprite->wmat),
+                                          bbox(vec2_mul(sprite->size, min),
+                                               vec2_mul(sprite->size, max)))))
+        {
+            range = layer->nvisible > 0
+                ? &layer->visible[layer->nvisible - 1] : NULL;
+            if (range && i - range->end <= MAX_DRAW_GAP)
+                range->end = i + 1;
+            else
+            {
+                range = &layer->visible[layer->nvisible++];
+                range->first = i;
+                range->end = i + 1;
+            }
+        }
+
+        ++i;
+    }
+    layer->ninstances = n;
+}
+
+/*
+ * move on to next vbo of ring, upload runs of instances changed since it
+ * was last updated
+ */
+static void _dynamic_update()
+{
+    Layer *layer = &dynamic_layer;
+    unsigned int i, curr, synced, run_begin = 0, run_end = 0;
+
+    ++layer->frame;
+    layer->curr = curr = (layer->curr + 1) % layer->nbuffers;
+    _dynamic_pack();
+
+    glBindBuffer(GL_ARRAY_BUFFER, layer->vbos[curr]);
+
+    /* out of space? new store, everything needs uploading */
+    synced = layer->synced[curr];
+    if (layer->stores[curr] < layer->capacity)
+    {
+        glBufferData(GL_ARRAY_BUFFER,
+                     layer->capacity * sizeof(SpriteInstance),
+                     NULL, GL_DYNAMIC_DRAW);
+        layer->stores[curr] = layer->capacity;
+        synced = 0;
+    }
+
+    for (i = 0; i < layer->ninstances; ++i)
+        if (layer->changed[i] > synced)
+        {
+            if (run_end > run_begin && i - run_end <= MAX_UPLOAD_GAP)
+                run_end = i + 1;
+            else
+            {
+                if (run_end > run_begin)
+                    _upload(layer, run_begin, run_end);
+                run_begin = i;
+                run_end = i + 1;
+            }
+        }
+    if (run_end > run_begin)
+        _upload(layer, run_begin, run_end);
+
+    layer->synced[curr] = layer->frame;
+}
+
+/* pack and upload all static sprites, only if one changed */
+static void _static_update()
+{
+    Layer *layer = &static_layer;
+    Sprite *sprite;
+    Entity ent;
+    unsigned int i, n;
+
+    if (!static_dirty)
+        return;
+
+    n = entitypool_size(static_pool);
+    _layer_reserve(layer, n);
+
+    i = 0;
+    layer->nbatches = 0;
+    entitypool_foreach(sprite, static_pool)
+    {
+        ent = sprite->pool_elem.ent;
+        sprite->wmat = mat3_to_affine(transform_get_world_matrix(ent));
+        sprite->dirty_count = transform_get_world_dirty_count(ent);
+
+        _layer_batch(layer, sprite, i);
+        _instance(&layer->instances[i++], sprite);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, layer->vbos[0]);
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(SpriteInstance),
+                 layer->instances, GL_STATIC_DRAW);
+    bytes_uploaded += n * sizeof(SpriteInstance);
+
+    layer->ninstances = n;
+    static_dirty = false;
+}
+
+/* draw instances [first, end) of layer, with atlas bound */
+static void _draw(Layer *layer, unsigned int atlas_index,
+                  unsigned int first, unsigned int end)
+{
+    const char *atlas;
+    Vec2 atlas_size;
+    Range *r, *r_end;
+    unsigned int lo, hi, mid;
+
+    /* find first visible range ending past first */
+    r = r_end = NULL;
+    if (layer->culled)
+    {
+        lo = 0;
+        hi = layer->nvisible;
+        while (lo < hi)
+        {
+            mid = (lo + hi) / 2;
+            if (layer->visible[mid].end <= first)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        r = layer->visible + lo;
+        r_end = layer->visible + layer->nvisible;
+        if (r == r_end || r->first >= end)
+            return; /* nothing in view */
+    }
+
+    atlas = _atlas_name(atlas_index);
+    texture_bind(atlas);
+    atlas_size = texture_get_size(atlas);
+    glUniform2fv(glGetUniformLocation(program, "atlas_size"), 1,
+                 (const GLfloat *) &atlas_size);
+
+    glBindVertexArray(layer->vaos[layer->curr]);
+    if (!layer->culled)
+    {
+        glDrawArrays(GL_POINTS, first, end - first);
+        return;
+    }
+
+    /* a call per visible range, clipped */
+    for (; r != r_end && r->first < end; ++r)
+        glDrawArrays(GL_POINTS, r->first > first ? r->first : first,
+                     (r->end < end ? r->end : end)
+                     - (r->first > first ? r->first : first));
+}
+
+static int _depth(EntityPool *p, unsigned int i)
+{
+    return ((Sprite *) entitypool_nth(p, i))->depth;
+}
+
+/* first in [first, end) of depth-sorted p with depth < bound, else end */
+static unsigned int _depth_split(EntityPool *p, unsigned int first,
+                                 unsigned int end, int bound)
+{
+    unsigned int mid;
+
+    while (first < end)
+    {
+        mid = (first + end) / 2;
+        if (_depth(p, mid) >= bound)
+            first = mid + 1;
+        else
+            end = mid;
+    }
+    return first;
 }
 
 void sprite_draw_all()
 {
-    unsigned int nsprites;
+    Batch *d, *d_end, *s, *s_end;
+    unsigned int d_pos, s_pos, d_stop, s_stop, split;
 
-    /* depth sort */
+    /* depth sort -- only does work if order changed */
     entitypool_sort(pool, _depth_compare);
+    entitypool_sort(static_pool, _depth_compare);
 
     /* bind program, update uniforms */
     glUseProgram(program);
@@ -229,17 +807,75 @@ void sprite_draw_all()
                        1, GL_FALSE,
                        (const GLfloat *) camera_get_inverse_view_matrix_ptr());
 
-    /* bind atlas */
+    /* upload */
+    bytes_uploaded = 0;
+    _static_update();
+    _dynamic_update();
+
+    /*
+     * draw! both layers' batches are in depth order, merge them, static
+     * first on equal depth -- a batch is split only where the other
+     * layer's next instance has to go in between
+     */
     glActiveTexture(GL_TEXTURE0);
-    texture_bind(atlas);
+    d = dynamic_layer.batches;
+    d_end = d + dynamic_layer.nbatches;
+    s = static_layer.batches;
+    s_end = s + static_layer.nbatches;
+    d_pos = d != d_end ? d->first : 0;
+    s_pos = s != s_end ? s->first : 0;
+    while (d != d_end || s != s_end)
+    {
+        d_stop = d != d_end ? d->first + d->count : 0;
+        s_stop = s != s_end ? s->first + s->count : 0;
 
-    /* draw! */
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    nsprites = entitypool_size(pool);
-    glBufferData(GL_ARRAY_BUFFER, nsprites * sizeof(Sprite),
-                 entitypool_begin(pool), GL_STREAM_DRAW);
-    glDrawArrays(GL_POINTS, 0, nsprites);
+        if (s != s_end && (d == d_end || _depth(static_pool, s_pos)
+                           >= _depth(pool, d_pos)))
+        {
+            /* static while depth >= next dynamic */
+            split = d == d_end ? s_stop
+                : _depth_split(static_pool, s_pos, s_stop,
+                               _depth(pool, d_pos));
+            _draw(&static_layer, s->atlas, s_pos, split);
+            if ((s_pos = split) == s_stop && ++s != s_end)
+                s_pos = s->first;
+        }
+        else
+        {
+            /* dynamic while depth > next static */
+            split = s == s_end ? d_stop
+                : _depth_split(pool, d_pos, d_stop,
+                               _depth(static_pool, s_pos) + 1);
+            _draw(&dynamic_layer, d->atlas, d_pos, split);
+            if ((d_pos = split) == d_stop && ++d != d_end)
+                d_pos = d->first;
+        }
+    }
+}
+
+static void _sprite_save(Sprite *sprite, Store *s)
+{
+    vec2_save(&sprite->size, "size", s);
+    vec2_save(&sprite->texcell, "texcell", s);
+    vec2_save(&sprite->texsize, "texsize", s);
+    int_save(&sprite->depth, "depth", s);
+    if (sprite->atlas != 0)
+        string_save((const char **) &_atlas_name(sprite->atlas), "atlas", s);
+}
+static void _sprite_load(Sprite *sprite, bool is_static, Store *s)
+{
+    char *tatlas;
+
+    vec2_load(&sprite->size, "size", vec2(1, 1), s);
+    vec2_load(&sprite->texcell, "texcell", vec2(32, 32), s);
+    vec2_load(&sprite->texsize, "texsize", vec2(32, 32), s);
+    int_load(&sprite->depth, "depth", 0, s);
+
+    string_load(&tatlas, "atlas", NULL, s);
+    sprite->atlas = _atlas_index(tatlas, false);
+    free(tatlas);
+
+    sprite->is_static = is_static;
 }
 
 void sprite_save_all(Store *s)
@@ -249,15 +885,13 @@ void sprite_save_all(Store *s)
 
     if (store_child_save(&t, "sprite", s))
     {
-        string_save((const char **) &atlas, "atlas", t);
+        string_save((const char **) &_atlas_name(0), "atlas", t);
 
         entitypool_save_foreach(sprite, sprite_s, pool, "pool", t)
-        {
-            vec2_save(&sprite->size, "size", sprite_s);
-            vec2_save(&sprite->texcell, "texcell", sprite_s);
-            vec2_save(&sprite->texsize, "texsize", sprite_s);
-            int_save(&sprite->depth, "depth", sprite_s);
-        }
+            _sprite_save(sprite, sprite_s);
+        entitypool_save_foreach(sprite, sprite_s, static_pool,
+                                "static_pool", t)
+            _sprite_save(sprite, sprite_s);
     }
 }
 void sprite_load_all(Store *s)
@@ -276,12 +910,13 @@ void sprite_load_all(Store *s)
         }
 
         entitypool_load_foreach(sprite, sprite_s, pool, "pool", t)
-        {
-            vec2_load(&sprite->size, "size", vec2(1, 1), sprite_s);
-            vec2_load(&sprite->texcell, "texcell", vec2(32, 32), sprite_s);
-            vec2_load(&sprite->texsize, "texsize", vec2(32, 32), sprite_s);
-            int_load(&sprite->depth, "depth", 0, sprite_s);
-        }
+            _sprite_load(sprite, false, sprite_s);
+        entitypool_load_foreach(sprite, sprite_s, static_pool,
+                                "static_pool", t)
+            _sprite_load(sprite, true, sprite_s);
+        entitypool_mark_unsorted(pool);
+        entitypool_mark_unsorted(static_pool);
+        static_dirty = true;
     }
 }
 
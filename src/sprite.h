@@ -3,17 +3,29 @@
 
 #include "saveload.h"
 #include "entity.h"
+#include "entitypool.h"
 #include "vec2.h"
 #include "script_export.h"
 
 SCRIPT(sprite,
 
+       /* default atlas, used by sprites that don't set their own */
        EXPORT void sprite_set_atlas(const char *filename);
        EXPORT const char *sprite_get_atlas();
 
        EXPORT void sprite_add(Entity ent);
        EXPORT void sprite_remove(Entity ent);
        EXPORT bool sprite_has(Entity ent);
+       /* for entitypool_join_*(), has only sprites that aren't static */
+       EXPORT EntityPool *sprite_get_pool();
+
+       /*
+        * add to n entities at once -- sizes, texcells, texsizes, depths
+        * are arrays of n initial values, or NULL to use the defaults
+        */
+       EXPORT void sprite_add_n(unsigned int n, const Entity *ents,
+                                const Vec2 *sizes, const Vec2 *texcells,
+                                const Vec2 *texsizes, const int *depths);
 
        /* size to draw in world units, centered at transform position */
        EXPORT void sprite_set_size(Entity ent, Vec2 size);
@@ -27,12 +39,40 @@ SCRIPT(sprite,
        EXPORT void sprite_set_texsize(Entity ent, Vec2 texsize);
        EXPORT Vec2 sprite_get_texsize(Entity ent);
 
+       /*
+        * atlas for just this sprite, NULL to go back to the default --
+        * sprites are drawn in one call per run of the same atlas in depth
+        * order, so prefer few atlases per depth
+        */
+       EXPORT void sprite_set_entity_atlas(Entity ent, const char *filename);
+       EXPORT const char *sprite_get_entity_atlas(Entity ent);
+
        /* lower depth drawn on top */
        EXPORT void sprite_set_depth(Entity ent, int depth);
        EXPORT int sprite_get_depth(Entity ent);
 
+       /*
+        * static sprites are drawn from a separate buffer that's rebuilt
+        * only when one of them changes, and are skipped in per-frame
+        * updates -- for sprites that rarely move, such as walls, tiles
+        *
+        * moves, including of ancestors, are noticed through
+        * transform_get_world_dirty_count(...)
+        */
+       EXPORT void sprite_set_static(Entity ent, bool is_static);
+       EXPORT bool sprite_get_static(Entity ent);
+
+       /* instance data sent to GPU by last draw, to check upload cost */
+       EXPORT unsigned int sprite_get_bytes_uploaded();
+
     )
 
+/*
+ * load texture for use as an atlas, err is whether to error(...) if bad --
+ * for other systems that draw from atlases, returns whether loaded
+ */
+bool sprite_load_atlas(const char *filename, bool err);
+
 void sprite_init();
 void sprite_deinit();
 void sprite_update_all();
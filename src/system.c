@@ -11,12 +11,17 @@
 #include "camera.h"
 #include "texture.h"
 #include "sprite.h"
+#include "animation.h"
+#include "tilemap.h"
+#include "particle.h"
 #include "gui.h"
 #include "console.h"
 #include "scratch.h"
 #include "physics.h"
 #include "edit.h"
 #include "sound.h"
+#include "frame.h"
+#include "worker.h"
 
 #include "test/keyboard_controlled.h"
 
@@ -55,12 +60,16 @@ static void _scroll(Vec2 scroll)
 
 void system_init()
 {
+    worker_init();
     input_init();
     entity_init();
     transform_init();
     camera_init();
     texture_init();
     sprite_init();
+    animation_init();
+    tilemap_init();
+    particle_init();
     gui_init();
     console_init();
     sound_init();
@@ -84,6 +93,9 @@ void system_deinit()
     physics_deinit();
     sound_deinit();
     console_deinit();
+    particle_deinit();
+    tilemap_deinit();
+    animation_deinit();
     sprite_deinit();
     gui_deinit();
     texture_deinit();
@@ -91,6 +103,8 @@ void system_deinit()
     transform_deinit();
     entity_deinit();
     input_deinit();
+    worker_deinit();
+    frame_deinit();
 }
 
 void system_update_all()
@@ -110,7 +124,10 @@ void system_update_all()
     transform_update_all();
     camera_update_all();
     gui_update_all();
+    animation_update_all();
     sprite_update_all();
+    tilemap_update_all();
+    particle_update_all();
     sound_update_all();
 
     edit_update_all();
@@ -120,12 +137,16 @@ void system_update_all()
     entity_update_all();
 
     gui_event_clear();
+
+    frame_update_all();
 }
 
 void system_draw_all()
 {
     script_draw_all();
+    tilemap_draw_all();
     sprite_draw_all();
+    particle_draw_all();
     edit_draw_all();
     physics_draw_all();
     gui_draw_all();
@@ -145,6 +166,9 @@ static void _saveload_all(void *s, bool save)
     saveload(transform);
     saveload(camera);
     saveload(sprite);
+    saveload(animation);
+    saveload(tilemap);
+    saveload(particle);
     saveload(physics);
     saveload(gui);
     saveload(edit);
@@ -2,7 +2,7 @@
 
 #include <string.h>
 #include <stdlib.h>
-#include <GL/glew.h>
+#include "glew_glfw.h"
 #include <stb_image.h>
 #include <sys/stat.h>
 #include <time.h>
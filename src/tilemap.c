@@ -0,0 +1,612 @@
+#include "tilemap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "array.h"
+#include "dirs.h"
+#include "frame.h"
+#include "gfx.h"
+#include "texture.h"
+#include "transform.h"
+#include "camera.h"
+#include "sprite.h"
+#include "edit.h"
+
+#define CHUNK_SIZE 16 /* tiles per side */
+#define CHUNK_TILES (CHUNK_SIZE * CHUNK_SIZE)
+
+typedef struct TileVertex TileVertex;
+struct TileVertex
+{
+    Vec2 position;
+    Vec2 texcell;
+};
+
+typedef struct Chunk Chunk;
+struct Chunk
+{
+    int x, y; /* in chunks, chunk (x, y) has tile (x, y) * CHUNK_SIZE */
+    int tiles[CHUNK_TILES]; /* row by row from the bottom */
+    unsigned int ntiles; /* number of non-empty tiles */
+
+    bool dirty; /* needs meshing? */
+    GLuint vao, vbo;
+    unsigned int nverts;
+};
+
+typedef struct Tilemap Tilemap;
+struct Tilemap
+{
+    EntityPoolElem pool_elem;
+
+    char *atlas; /* NULL for default sprite atlas */
+    Vec2 cell_size;
+    Vec2 texsize;
+
+    Array *chunks; /* Chunk *, sorted by (y, x) for binary search */
+    Vec2 mesh_atlas_size; /* atlas size meshes were built for */
+};
+
+static GLuint program;
+
+static EntityPool *pool;
+
+/* ------------------------------------------------------------------------- */
+
+/* division rounding towards negative infinity */
+static inline int _floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+static Tilemap *_get(Entity ent)
+{
+    Tilemap *tilemap = entitypool_get(pool, ent);
+    error_assert(tilemap, "entity must be in tilemap system");
+    return tilemap;
+}
+
+static const char *_atlas(Tilemap *tilemap)
+{
+    return tilemap->atlas ? tilemap->atlas : sprite_get_atlas();
+}
+
+/* compare chunk's coordinates with (x, y), row by row */
+static int _chunk_compare(Chunk *chunk, int x, int y)
+{
+    if (chunk->y != y)
+        return chunk->y < y ? -1 : 1;
+    if (chunk->x != x)
+        return chunk->x < x ? -1 : 1;
+    return 0;
+}
+
+/* find chunk at chunk coordinates (x, y), add if not found and asked to */
+static Chunk *_chunk_get(Tilemap *tilemap, int x, int y, bool add)
+{
+    Chunk **chunks, *chunk;
+    unsigned int lo, hi, mid, i, n;
+    int c;
+
+    /* binary search, lo ends up where it would go */
+    chunks = array_begin(tilemap->chunks);
+    lo = 0;
+    hi = array_length(tilemap->chunks);
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        c = _chunk_compare(chunks[mid], x, y);
+        if (c == 0)
+            return chunks[mid];
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!add)
+        return NULL;
+
+    chunk = malloc(sizeof(Chunk));
+    chunk->x = x;
+    chunk->y = y;
+    for (i = 0; i < CHUNK_TILES; ++i)
+        chunk->tiles[i] = -1;
+    chunk->ntiles = 0;
+    chunk->dirty = true;
+    chunk->nverts = 0;
+
+    /* insert at lo */
+    array_add(tilemap->chunks);
+    chunks = array_begin(tilemap->chunks);
+    n = array_length(tilemap->chunks);
+    memmove(chunks + lo + 1, chunks + lo, (n - 1 - lo) * sizeof(Chunk *));
+    chunks[lo] = chunk;
+
+    /* make vao, vbo, bind attributes */
+    glGenVertexArrays(1, &chunk->vao);
+    glBindVertexArray(chunk->vao);
+    glGenBuffers(1, &chunk->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "position",
+                           TileVertex, position);
+    gfx_bind_vertex_attrib(program, GL_FLOAT, 2, "texcell",
+                           TileVertex, texcell);
+
+    return chunk;
+}
+static void _chunk_free(Chunk *chunk)
+{
+    glDeleteBuffers(1, &chunk->vbo);
+    glDeleteVertexArrays(1, &chunk->vao);
+    free(chunk);
+}
+
+static void _set_tile(Tilemap *tilemap, int x, int y, int tile)
+{
+    Chunk *chunk;
+    int cx, cy, *t;
+
+    if (tile < 0)
+        tile = -1;
+
+    cx = _floor_div(x, CHUNK_SIZE);
+    cy = _floor_div(y, CHUNK_SIZE);
+    chunk = _chunk_get(tilemap, cx, cy, tile >= 0);
+    if (!chunk)
+        return; /* clearing a tile in a chunk that doesn't exist */
+
+    t = &chunk->tiles[(y - cy * CHUNK_SIZE) * CHUNK_SIZE
+                      + (x - cx * CHUNK_SIZE)];
+    if (*t == tile)
+        return;
+
+    if (*t < 0)
+        ++chunk->ntiles;
+    else if (tile < 0)
+        --chunk->ntiles;
+    *t = tile;
+    chunk->dirty = true;
+}
+
+/* chunk's box in tilemap space */
+static BBox _chunk_bbox(Tilemap *tilemap, Chunk *chunk)
+{
+    Vec2 min, max;
+
+    min = vec2(chunk->x * CHUNK_SIZE * tilemap->cell_size.x,
+               chunk->y * CHUNK_SIZE * tilemap->cell_size.y);
+    max = vec2_add(min, vec2_scalar_mul(tilemap->cell_size, CHUNK_SIZE));
+    return bbox_bound(min, max);
+}
+
+static inline TileVertex *_vert(TileVertex *v, Scalar px, Scalar py,
+                                Scalar tx, Scalar ty)
+{
+    v->position = vec2(px, py);
+    v->texcell = vec2(tx, ty);
+    return v + 1;
+}
+
+/* two triangles per non-empty tile */
+static void _chunk_mesh(Tilemap *tilemap, Chunk *chunk, Vec2 atlas_size)
+{
+    TileVertex *verts, *v;
+    unsigned int i, j, cols;
+    int tile;
+    Vec2 cs, ts, min, max, tmin, tmax;
+
+    cs = tilemap->cell_size;
+    ts = tilemap->texsize;
+    cols = ts.x > 0 ? atlas_size.x / ts.x : 0;
+    if (cols == 0)
+        cols = 1;
+
+    verts = frame_alloc(6 * chunk->ntiles * sizeof(TileVertex));
+    v = verts;
+    for (i = 0; i < CHUNK_SIZE; ++i)
+        for (j = 0; j < CHUNK_SIZE; ++j)
+        {
+            tile = chunk->tiles[i * CHUNK_SIZE + j];
+            if (tile < 0)
+                continue;
+
+            min = vec2((chunk->x * CHUNK_SIZE + (int) j) * cs.x,
+                       (chunk->y * CHUNK_SIZE + (int) i) * cs.y);
+            max = vec2_add(min, cs);
+            tmin = vec2((tile % cols) * ts.x,
+                        atlas_size.y - (tile / cols + 1) * ts.y);
+            tmax = vec2_add(tmin, ts);
+
+            v = _vert(v, min.x, min.y, tmin.x, tmin.y);
+            v = _vert(v, max.x, min.y, tmax.x, tmin.y);
+            v = _vert(v, max.x, max.y, tmax.x, tmax.y);
+            v = _vert(v, min.x, min.y, tmin.x, tmin.y);
+            v = _vert(v, max.x, max.y, tmax.x, tmax.y);
+            v = _vert(v, min.x, max.y, tmin.x, tmax.y);
+        }
+
+    chunk->nverts = v - verts;
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBufferData(GL_ARRAY_BUFFER, chunk->nverts * sizeof(TileVertex),
+                 verts, GL_STATIC_DRAW);
+    chunk->dirty = false;
+}
+
+static void _mark_all_dirty(Tilemap *tilemap)
+{
+    Chunk **chunk;
+
+    array_foreach(chunk, tilemap->chunks)
+        (*chunk)->dirty = true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void tilemap_add(Entity ent)
+{
+    Tilemap *tilemap;
+
+    if (entitypool_get(pool, ent))
+        return;
+
+    transform_add(ent);
+
+    tilemap = entitypool_add(pool, ent);
+    tilemap->atlas = NULL;
+    tilemap->cell_size = vec2(1, 1);
+    tilemap->texsize = vec2(32, 32);
+    tilemap->chunks = array_new(Chunk *);
+    tilemap->mesh_atlas_size = vec2_zero;
+}
+void tilemap_remove(Entity ent)
+{
+    Tilemap *tilemap;
+    Chunk **chunk;
+
+    tilemap = entitypool_get(pool, ent);
+    if (tilemap)
+    {
+        array_foreach(chunk, tilemap->chunks)
+            _chunk_free(*chunk);
+        array_free(tilemap->chunks);
+        free(tilemap->atlas);
+    }
+    entitypool_remove(pool, ent);
+}
+bool tilemap_has(Entity ent)
+{
+    return entitypool_get(pool, ent) != NULL;
+}
+EntityPool *tilemap_get_pool()
+{
+    return pool;
+}
+
+void tilemap_set_atlas(Entity ent, const char *filename)
+{
+    Tilemap *tilemap;
+    char *name = NULL;
+
+    tilemap = _get(ent);
+    if (filename)
+    {
+        sprite_load_atlas(filename, true);
+        name = malloc(strlen(filename) + 1);
+        strcpy(name, filename);
+    }
+    free(tilemap->atlas); /* after copy, filename might be this */
+    tilemap->atlas = name;
+}
+const char *tilemap_get_atlas(Entity ent)
+{
+    return _get(ent)->atlas;
+}
+
+void tilemap_set_cell_size(Entity ent, Vec2 cell_size)
+{
+    Tilemap *tilemap = _get(ent);
+    tilemap->cell_size = cell_size;
+    _mark_all_dirty(tilemap);
+}
+Vec2 tilemap_get_cell_size(Entity ent)
+{
+    return _get(ent)->cell_size;
+}
+
+void tilemap_set_texsize(Entity ent, Vec2 texsize)
+{
+    Tilemap *tilemap = _get(ent);
+    tilemap->texsize = texsize;
+    _mark_all_dirty(tilemap);
+}
+Vec2 tilemap_get_texsize(Entity ent)
+{
+    return _get(ent)->texsize;
+}
+
+void tilemap_set_tile(Entity ent, int x, int y, int tile)
+{
+    _set_tile(_get(ent), x, y, tile);
+}
+int tilemap_get_tile(Entity ent, int x, int y)
+{
+    Chunk *chunk;
+    int cx, cy;
+
+    cx = _floor_div(x, CHUNK_SIZE);
+    cy = _floor_div(y, CHUNK_SIZE);
+    chunk = _chunk_get(_get(ent), cx, cy, false);
+    if (!chunk)
+        return -1;
+    return chunk->tiles[(y - cy * CHUNK_SIZE) * CHUNK_SIZE
+                        + (x - cx * CHUNK_SIZE)];
+}
+
+void tilemap_set_tiles(Entity ent, int x, int y,
+                       unsigned int w, unsigned int h, const int *tiles)
+{
+    Tilemap *tilemap;
+    unsigned int i, j;
+
+    tilemap = _get(ent);
+    for (i = 0; i < h; ++i)
+        for (j = 0; j < w; ++j)
+            _set_tile(tilemap, x + j, y + i, tiles[i * w + j]);
+}
+void tilemap_clear(Entity ent)
+{
+    Tilemap *tilemap;
+    Chunk **chunk;
+    unsigned int i;
+
+    tilemap = _get(ent);
+    array_foreach(chunk, tilemap->chunks)
+    {
+        for (i = 0; i < CHUNK_TILES; ++i)
+            (*chunk)->tiles[i] = -1;
+        (*chunk)->ntiles = 0;
+        (*chunk)->dirty = true;
+    }
+}
+
+Vec2 tilemap_world_to_tile(Entity ent, Vec2 p)
+{
+    Tilemap *tilemap = _get(ent);
+    p = vec2_div(transform_world_to_local(ent, p), tilemap->cell_size);
+    return vec2(scalar_floor(p.x), scalar_floor(p.y));
+}
+
+unsigned int tilemap_get_num_chunks(Entity ent)
+{
+    return array_length(_get(ent)->chunks);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void tilemap_init()
+{
+    pool = entitypool_new(Tilemap);
+
+    program = gfx_create_program(data_path("tilemap.vert"),
+                                 NULL,
+                                 data_path("tilemap.frag"));
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex0"), 0);
+}
+void tilemap_deinit()
+{
+    while (entitypool_size(pool) > 0)
+        tilemap_remove(((EntityPoolElem *) entitypool_begin(pool))->ent);
+    entitypool_free(pool);
+
+    glDeleteProgram(program);
+}
+
+void tilemap_update_all()
+{
+    Tilemap *tilemap;
+    Chunk **chunks, *chunk;
+    Vec2 atlas_size;
+    BBox bbox;
+    unsigned int i, j, n;
+
+    entitypool_remove_destroyed(pool, tilemap_remove);
+
+    entitypool_foreach(tilemap, pool)
+    {
+        /* atlas reloaded with a new size? texcells move */
+        atlas_size = texture_get_size(_atlas(tilemap));
+        if (atlas_size.x != tilemap->mesh_atlas_size.x
+            || atlas_size.y != tilemap->mesh_atlas_size.y)
+        {
+            tilemap->mesh_atlas_size = atlas_size;
+            _mark_all_dirty(tilemap);
+        }
+
+        /* drop empty chunks keeping the rest in order, mesh changed ones */
+        chunks = array_begin(tilemap->chunks);
+        n = array_length(tilemap->chunks);
+        for (i = j = 0; i < n; ++i)
+        {
+            chunk = chunks[i];
+            if (chunk->ntiles == 0)
+            {
+                _chunk_free(chunk);
+                continue;
+            }
+            if (chunk->dirty)
+                _chunk_mesh(tilemap, chunk, atlas_size);
+            chunks[j++] = chunk;
+        }
+        for (; j < n; ++j)
+            array_pop(tilemap->chunks);
+
+        if (array_length(tilemap->chunks) > 0)
+        {
+            chunks = array_begin(tilemap->chunks);
+            bbox = _chunk_bbox(tilemap, chunks[0]);
+            for (i = 1; i < array_length(tilemap->chunks); ++i)
+                bbox = bbox_merge(bbox, _chunk_bbox(tilemap, chunks[i]));
+            edit_bboxes_update(tilemap->pool_elem.ent, bbox);
+        }
+    }
+}
+
+void tilemap_draw_all()
+{
+    Tilemap *tilemap;
+    Chunk **chunk;
+    const char *atlas;
+    Vec2 atlas_size;
+    Mat3 wmat;
+
+    glUseProgram(program);
+    glUniformMatrix3fv(glGetUniformLocation(program, "inverse_view_matrix"),
+                       1, GL_FALSE,
+                       (const GLfloat *) camera_get_inverse_view_matrix_ptr());
+    glActiveTexture(GL_TEXTURE0);
+
+    /* a draw call per visible chunk */
+    entitypool_foreach(tilemap, pool)
+    {
+        atlas = _atlas(tilemap);
+        texture_bind(atlas);
+        atlas_size = texture_get_size(atlas);
+        glUniform2fv(glGetUniformLocation(program, "atlas_size"), 1,
+                     (const GLfloat *) &atlas_size);
+
+        wmat = transform_get_world_matrix(tilemap->pool_elem.ent);
+        glUniformMatrix3fv(glGetUniformLocation(program, "wmat"),
+                           1, GL_FALSE, (const GLfloat *) &wmat);
+
+        array_foreach(chunk, tilemap->chunks)
+            if ((*chunk)->nverts > 0
+                && camera_in_view(bbox_transform(wmat,
+                                                 _chunk_bbox(tilemap,
+                                                             *chunk))))
+            {
+                glBindVertexArray((*chunk)->vao);
+                glDrawArrays(GL_TRIANGLES, 0, (*chunk)->nverts);
+            }
+    }
+}
+
+/*
+ * all of a tilemap's chunks are saved in one compressed "tiles" child --
+ * number of chunks, then for each its x, y and its tiles run-length
+ * encoded: number of runs, then length and tile of each run
+ */
+static void _tiles_save(Chunk *chunk, Store *t)
+{
+    unsigned int i, j, nruns, len;
+
+    for (nruns = 0, i = 0; i < CHUNK_TILES; i = j, ++nruns)
+        for (j = i + 1; j < CHUNK_TILES && chunk->tiles[j] == chunk->tiles[i];
+             ++j);
+    uint_save(&nruns, NULL, t);
+
+    for (i = 0; i < CHUNK_TILES; i = j)
+    {
+        for (j = i + 1; j < CHUNK_TILES && chunk->tiles[j] == chunk->tiles[i];
+             ++j);
+        len = j - i;
+        uint_save(&len, NULL, t);
+        int_save(&chunk->tiles[i], NULL, t);
+    }
+}
+static void _tiles_load(Chunk *chunk, Store *t)
+{
+    unsigned int nruns, len, i = 0;
+    int tile;
+
+    uint_load(&nruns, NULL, 0, t);
+    while (nruns-- > 0)
+    {
+        uint_load(&len, NULL, 0, t);
+        int_load(&tile, NULL, -1, t);
+        for (; len > 0 && i < CHUNK_TILES; --len, ++i)
+        {
+            chunk->tiles[i] = tile < 0 ? -1 : tile;
+            if (tile >= 0)
+                ++chunk->ntiles;
+        }
+    }
+}
+
+void tilemap_save_all(Store *s)
+{
+    Store *t, *tilemap_s, *tiles_s;
+    Tilemap *tilemap;
+    Chunk **chunk;
+    unsigned int nchunks;
+
+    if (store_child_save(&t, "tilemap", s))
+        entitypool_save_foreach(tilemap, tilemap_s, pool, "pool", t)
+        {
+            string_save((const char **) &tilemap->atlas, "atlas", tilemap_s);
+            vec2_save(&tilemap->cell_size, "cell_size", tilemap_s);
+            vec2_save(&tilemap->texsize, "texsize", tilemap_s);
+
+            if (store_child_save_compressed(&tiles_s, "tiles", tilemap_s))
+            {
+                nchunks = 0;
+                array_foreach(chunk, tilemap->chunks)
+                    if ((*chunk)->ntiles > 0)
+                        ++nchunks;
+                uint_save(&nchunks, NULL, tiles_s);
+
+                array_foreach(chunk, tilemap->chunks)
+                    if ((*chunk)->ntiles > 0)
+                    {
+                        int_save(&(*chunk)->x, NULL, tiles_s);
+                        int_save(&(*chunk)->y, NULL, tiles_s);
+                        _tiles_save(*chunk, tiles_s);
+                    }
+            }
+        }
+}
+void tilemap_load_all(Store *s)
+{
+    Store *t, *pool_s, *tilemap_s, *tiles_s;
+    Tilemap *tilemap;
+    Entity ent;
+    char *atlas;
+    unsigned int nchunks;
+    int x, y;
+
+    if (store_child_load(&t, "tilemap", s)
+        && store_child_load(&pool_s, "pool", t))
+        while (store_child_load(&tilemap_s, NULL, pool_s))
+        {
+            /* replace whatever was there, chunks are allocated per entity */
+            error_assert(entity_load(&ent, "pool_elem", entity_nil,
+                                     tilemap_s),
+                         "saved EntityPoolElem entry must exist");
+            tilemap_remove(ent);
+            tilemap_add(ent);
+
+            string_load(&atlas, "atlas", NULL, tilemap_s);
+            tilemap_set_atlas(ent, atlas);
+            free(atlas);
+
+            tilemap = entitypool_get(pool, ent);
+            vec2_load(&tilemap->cell_size, "cell_size", vec2(1, 1),
+                      tilemap_s);
+            vec2_load(&tilemap->texsize, "texsize", vec2(32, 32),
+                      tilemap_s);
+
+            if (store_child_load(&tiles_s, "tiles", tilemap_s))
+            {
+                uint_load(&nchunks, NULL, 0, tiles_s);
+                while (nchunks-- > 0)
+                {
+                    int_load(&x, NULL, 0, tiles_s);
+                    int_load(&y, NULL, 0, tiles_s);
+                    _tiles_load(_chunk_get(tilemap, x, y, true), tiles_s);
+                }
+            }
+        }
+}
@@ -0,0 +1,69 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include "saveload.h"
+#include "entity.h"
+#include "entitypool.h"
+#include "vec2.h"
+#include "script_export.h"
+
+/*
+ * a grid of tiles on one entity, drawn from an atlas -- tile (x, y)
+ * covers [x, x + 1] * cell_size.x by [y, y + 1] * cell_size.y in the
+ * entity's space, and holds an atlas cell index or -1 if empty
+ *
+ * atlas cells are texsize pixels each, numbered left to right, top to
+ * bottom starting at 0
+ *
+ * the grid is stored in chunks of tiles that are meshed separately and
+ * only rebuilt when one of their tiles changes, each visible chunk is
+ * one draw call -- tilemaps are drawn under sprites
+ */
+
+SCRIPT(tilemap,
+
+       EXPORT void tilemap_add(Entity ent);
+       EXPORT void tilemap_remove(Entity ent);
+       EXPORT bool tilemap_has(Entity ent);
+       EXPORT EntityPool *tilemap_get_pool(); /* for entitypool_join_*() */
+
+       /* atlas to draw from, NULL means the default sprite atlas */
+       EXPORT void tilemap_set_atlas(Entity ent, const char *filename);
+       EXPORT const char *tilemap_get_atlas(Entity ent);
+
+       /* size of a tile in world units */
+       EXPORT void tilemap_set_cell_size(Entity ent, Vec2 cell_size);
+       EXPORT Vec2 tilemap_get_cell_size(Entity ent);
+
+       /* size of an atlas cell in pixels */
+       EXPORT void tilemap_set_texsize(Entity ent, Vec2 texsize);
+       EXPORT Vec2 tilemap_get_texsize(Entity ent);
+
+       EXPORT void tilemap_set_tile(Entity ent, int x, int y, int tile);
+       EXPORT int tilemap_get_tile(Entity ent, int x, int y);
+
+       /*
+        * set a w by h block of tiles with (x, y) as the lower-left
+        * corner, tiles[i * w + j] goes in (x + j, y + i)
+        */
+       EXPORT void tilemap_set_tiles(Entity ent, int x, int y,
+                                     unsigned int w, unsigned int h,
+                                     const int *tiles);
+       EXPORT void tilemap_clear(Entity ent);
+
+       /* tile coordinates of the tile containing world position p */
+       EXPORT Vec2 tilemap_world_to_tile(Entity ent, Vec2 p);
+
+       EXPORT unsigned int tilemap_get_num_chunks(Entity ent);
+
+    )
+
+void tilemap_init();
+void tilemap_deinit();
+void tilemap_update_all();
+void tilemap_draw_all();
+void tilemap_save_all(Store *s);
+void tilemap_load_all(Store *s);
+
+#endif
+
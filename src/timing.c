@@ -1,6 +1,7 @@
 #include "timing.h"
 
-#include <glew_glfw.h>
+#include "glew_glfw.h"
+#include "headless.h"
 
 Scalar timing_dt;
 Scalar timing_true_dt;
@@ -25,6 +26,11 @@ bool timing_get_paused()
     return paused;
 }
 
+static double _get_time()
+{
+    return headless_get_enabled() ? headless_get_time() : glfwGetTime();
+}
+
 static void _dt_update()
 {
     static double last_time = -1;
@@ -32,9 +38,9 @@ static void _dt_update()
 
     /* first update? */
     if (last_time < 0)
-        last_time = glfwGetTime();
+        last_time = _get_time();
 
-    curr_time = glfwGetTime();
+    curr_time = _get_time();
     timing_true_dt = curr_time - last_time;
     timing_dt = paused ? 0.0f : scale * timing_true_dt;
     last_time = curr_time;
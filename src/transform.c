@@ -5,10 +5,17 @@
 
 #include "error.h"
 #include "entitypool.h"
-#include "array.h"
 #include "saveload.h"
 #include "bbox.h"
 #include "edit.h"
+#include "frame.h"
+#include "worker.h"
+
+/* fewer transforms than this are updated serially */
+#define PARALLEL_MIN_TRANSFORMS 4096
+
+/* more tasks than threads so that uneven subtrees balance out */
+#define TASKS_PER_THREAD 4
 
 typedef struct Transform Transform;
 struct Transform
@@ -19,139 +26,300 @@ struct Transform
     Scalar rotation;
     Vec2 scale;
 
+    /* hierarchy links, entity_nil if none */
     Entity parent; /* root if entity_nil */
-    Array *children; /* empty if NULL */
+    Entity first_child;
+    Entity last_child;
+    Entity prev_sibling;
+    Entity next_sibling;
+    unsigned int nchildren;
+
+    unsigned int order; /* position in depth-first order, see _sort() */
 
-    Mat3 mat_cache; /* remember to update this! */
-    Mat3 worldmat_cache; /* cached on parent-child update */
+    /* use _update(...) before reading these */
+    Mat3 mat_cache; /* parent-space */
+    Mat3 worldmat_cache;
+    bool mat_dirty; /* mat_cache needs update */
+    bool worldmat_dirty; /* worldmat_cache needs update -- if set, also set
+                            for all descendants */
+
+    /* use _update_inverse(...) before reading these */
+    Mat3 worldmat_inv_cache;
+    bool worldmat_inv_dirty; /* worldmat_inv_cache needs update */
 
     unsigned int dirty_count;
+    unsigned int world_dirty_count; /* also counts ancestors' changes */
 };
 
+/*
+ * pool is kept in depth-first order (parents before children, subtrees
+ * contiguous) so that a single sweep can update all world matrices --
+ * changes to the hierarchy set order_dirty, order is restored in
+ * transform_update_all()
+ */
 static EntityPool *pool;
+static bool order_dirty = false;
+
+static bool parallel = true;
 
 /* ------------------------------------------------------------------------- */
 
-static void _update_child(Transform *parent, Entity ent)
+static inline Transform *_get(Entity ent)
 {
-    Transform *transform;
-    Entity *child;
+    return entitypool_get(pool, ent);
+}
 
-    transform = entitypool_get(pool, ent);
-    error_assert(transform);
-    transform->worldmat_cache = mat3_mul(parent->worldmat_cache,
-                                         transform->mat_cache);
-    if (transform->children)
-        array_foreach(child, transform->children)
-            _update_child(transform, *child);
+/*
+ * next transform after t in depth-first walk of subtree at root, NULL at
+ * end -- skips t's descendants if skip_children
+ */
+static Transform *_subtree_next(Transform *t, Transform *root,
+                                bool skip_children)
+{
+    if (!skip_children && !entity_eq(t->first_child, entity_nil))
+        return _get(t->first_child);
+
+    for (; t != root; t = _get(t->parent))
+        if (!entity_eq(t->next_sibling, entity_nil))
+            return _get(t->next_sibling);
+    return NULL;
 }
-static void _modified(Transform *transform)
+
+/*
+ * matrices are computed lazily -- modifying a transform only marks it and
+ * its descendants, matrices are brought up to date when read or all at once
+ * in transform_update_all()
+ */
+
+/* bring matrices up to date, parents first */
+static void _update(Transform *transform)
 {
     Transform *parent;
-    Entity *child;
 
+    if (transform->mat_dirty)
+    {
+        transform->mat_cache = mat3_scaling_rotation_translation(
+            transform->scale,
+            transform->rotation,
+            transform->position
+            );
+        transform->mat_dirty = false;
+    }
+
+    if (transform->worldmat_dirty)
+    {
+        parent = _get(transform->parent);
+        if (parent)
+        {
+            _update(parent);
+            transform->worldmat_cache = mat3_mul(parent->worldmat_cache,
+                                                 transform->mat_cache);
+        }
+        else
+            transform->worldmat_cache = transform->mat_cache;
+        transform->worldmat_dirty = false;
+        transform->worldmat_inv_dirty = true;
+    }
+}
+
+/* bring inverse world matrix up to date, only done when asked for */
+static void _update_inverse(Transform *transform)
+{
+    Affine a;
+
+    _update(transform);
+    if (transform->worldmat_inv_dirty)
+    {
+        a = mat3_to_affine(transform->worldmat_cache);
+        mat3_affine_inverse_n(1, &a, &a);
+        transform->worldmat_inv_cache = mat3_from_affine(a);
+        transform->worldmat_inv_dirty = false;
+    }
+}
+
+static void _mark_worldmat_dirty(Transform *transform)
+{
+    Transform *t;
+    bool skip;
+
+    /*
+     * subtrees already marked have all descendants marked, and their world
+     * dirty counts already moved on since last read
+     */
+    for (t = transform; t; t = _subtree_next(t, transform, skip))
+    {
+        skip = t->worldmat_dirty;
+        if (!skip)
+            ++t->world_dirty_count;
+        t->worldmat_dirty = true;
+    }
+}
+static void _modified(Transform *transform)
+{
     ++transform->dirty_count;
 
-    transform->mat_cache = mat3_scaling_rotation_translation(
-        transform->scale,
-        transform->rotation,
-        transform->position
-        );
-
-    /* update our world matrix */
-    parent = entitypool_get(pool, transform->parent);
-    if (parent)
-        transform->worldmat_cache = mat3_mul(parent->worldmat_cache,
-                                             transform->mat_cache);
-    else
-        transform->worldmat_cache = transform->mat_cache;
+    transform->mat_dirty = true;
+    _mark_worldmat_dirty(transform);
+}
+
+static int _order_compare(const void *a, const void *b)
+{
+    const Transform *ta = a, *tb = b;
+
+    /* break ties by Entity index for stability */
+    if (ta->order == tb->order)
+        return ((int) entity_index(ta->pool_elem.ent))
+            - ((int) entity_index(tb->pool_elem.ent));
+    return ta->order < tb->order ? -1 : 1;
+}
+
+/* restore depth-first order of pool if hierarchy changed */
+static void _sort()
+{
+    Transform *root, *t;
+    unsigned int order;
 
-    /* update children world matrices */
-    if (transform->children)
-        array_foreach(child, transform->children)
-            _update_child(transform, *child);
+    if (!order_dirty)
+        return;
+
+    /* number in depth-first order starting at each root */
+    order = 0;
+    entitypool_foreach(root, pool)
+        if (entity_eq(root->parent, entity_nil))
+            for (t = root; t; t = _subtree_next(t, root, false))
+                t->order = order++;
+
+    entitypool_mark_unsorted(pool);
+    entitypool_sort(pool, _order_compare);
+    order_dirty = false;
 }
 
+/* unlink c from its parent p */
 static void _detach(Transform *p, Transform *c)
 {
-    Entity *child;
+    Transform *sib;
+
+    /* fix links around c */
+    if ((sib = _get(c->prev_sibling)))
+        sib->next_sibling = c->next_sibling;
+    else
+        p->first_child = c->next_sibling;
+    if ((sib = _get(c->next_sibling)))
+        sib->prev_sibling = c->prev_sibling;
+    else
+        p->last_child = c->prev_sibling;
+    --p->nchildren;
 
-    /* remove child -> parent link */
     c->parent = entity_nil;
+    c->prev_sibling = entity_nil;
+    c->next_sibling = entity_nil;
 
-    /* search for parent -> child link and remove it */
-    array_foreach(child, p->children)
-        if (entity_eq(*child, c->pool_elem.ent))
-        {
-            array_quick_remove(p->children,
-                               child - (Entity *) array_begin(p->children));
-            return;
-        }
+    order_dirty = true;
+}
+
+/* link c as last child of p */
+static void _attach(Transform *p, Transform *c)
+{
+    Transform *last;
+
+    c->parent = p->pool_elem.ent;
+    c->prev_sibling = p->last_child;
+    c->next_sibling = entity_nil;
+    if ((last = _get(p->last_child)))
+        last->next_sibling = c->pool_elem.ent;
+    else
+        p->first_child = c->pool_elem.ent;
+    p->last_child = c->pool_elem.ent;
+    ++p->nchildren;
 
-    _modified(c);
+    order_dirty = true;
 }
 
 static void _detach_all(Transform *t)
 {
-    Entity *child;
     Transform *p, *c;
     error_assert(t);
 
     /* our parent */
     if (!entity_eq(t->parent, entity_nil))
     {
-        p = entitypool_get(pool, t->parent);
+        p = _get(t->parent);
         error_assert(p);
         _detach(p, t);
     }
 
-    /* our children -- unset each child's parent then clear children array */
-    if (t->children)
+    /* our children */
+    while ((c = _get(t->first_child)))
     {
-        array_foreach(child, t->children)
-        {
-            c = entitypool_get(pool, *child);
-            error_assert(c);
-            c->parent = entity_nil;
-            _modified(c);
-        }
-        array_free(t->children);
-        t->children = NULL;
+        _detach(t, c);
+        _modified(c);
     }
 
     _modified(t);
 }
 
-void transform_add(Entity ent)
+static void _add(Entity ent, Vec2 position, Scalar rotation, Vec2 scale)
 {
     Transform *transform;
 
     if (entitypool_get(pool, ent))
         return;
 
+    /* new roots at the end keep depth-first order */
     transform = entitypool_add(pool, ent);
-    transform->position = vec2(0.0f, 0.0f);
-    transform->rotation = 0.0f;
-    transform->scale = vec2(1.0f, 1.0f);
+    transform->position = position;
+    transform->rotation = rotation;
+    transform->scale = scale;
 
     transform->parent = entity_nil;
-    transform->children = NULL;
-
+    transform->first_child = entity_nil;
+    transform->last_child = entity_nil;
+    transform->prev_sibling = entity_nil;
+    transform->next_sibling = entity_nil;
+    transform->nchildren = 0;
+
+    transform->mat_dirty = true;
+    transform->worldmat_dirty = false;
+    transform->worldmat_inv_dirty = true;
     transform->dirty_count = 0;
+    transform->world_dirty_count = 0;
 
     _modified(transform);
 }
+void transform_add(Entity ent)
+{
+    _add(ent, vec2(0.0f, 0.0f), 0.0f, vec2(1.0f, 1.0f));
+}
+void transform_add_n(unsigned int n, const Entity *ents,
+                     const Vec2 *positions, const Scalar *rotations,
+                     const Vec2 *scales)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; ++i)
+        _add(ents[i],
+             positions ? positions[i] : vec2(0.0f, 0.0f),
+             rotations ? rotations[i] : 0.0f,
+             scales ? scales[i] : vec2(1.0f, 1.0f));
+}
 void transform_remove(Entity ent)
 {
     Transform *transform = entitypool_get(pool, ent);
     if (transform)
+    {
         _detach_all(transform);
+        order_dirty = true; /* last element is swapped in */
+    }
     entitypool_remove(pool, ent);
 }
 bool transform_has(Entity ent)
 {
     return entitypool_get(pool, ent) != NULL;
 }
+EntityPool *transform_get_pool()
+{
+    return pool;
+}
 
 void transform_set_parent(Entity ent, Entity parent)
 {
@@ -175,14 +343,11 @@ void transform_set_parent(Entity ent, Entity parent)
     }
 
     /* attach to new */
-    t->parent = parent;
     if (!entity_eq(parent, entity_nil))
     {
         newp = entitypool_get(pool, parent);
         error_assert(newp);
-        if (!newp->children)
-            newp->children = array_new(Entity);
-        array_add_val(Entity, newp->children) = ent;
+        _attach(newp, t);
     }
 
     _modified(t);
@@ -197,13 +362,25 @@ unsigned int transform_get_num_children(Entity ent)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
-    return transform->children ? array_length(transform->children) : 0;
+    return transform->nchildren;
 }
 Entity *transform_get_children(Entity ent)
 {
-    Transform *transform = entitypool_get(pool, ent);
+    Transform *transform, *child;
+    Entity *children;
+    unsigned int i;
+
+    transform = entitypool_get(pool, ent);
     error_assert(transform);
-    return transform->children ? array_begin(transform->children) : NULL;
+    if (transform->nchildren == 0)
+        return NULL;
+
+    /* children are linked through the pool, gather them */
+    children = frame_alloc(transform->nchildren * sizeof(Entity));
+    for (i = 0, child = _get(transform->first_child); child;
+         ++i, child = _get(child->next_sibling))
+        children[i] = child->pool_elem.ent;
+    return children;
 }
 void transform_detach_all(Entity ent)
 {
@@ -213,15 +390,14 @@ void transform_detach_all(Entity ent)
 }
 void transform_destroy_rec(Entity ent)
 {
-    Transform *transform;
-    Entity *child;
+    Transform *transform, *t;
 
     transform = entitypool_get(pool, ent);
-    if (transform && transform->children)
-        array_foreach(child, transform->children)
-            transform_destroy_rec(*child);
-
-    entity_destroy(ent);
+    if (transform)
+        for (t = transform; t; t = _subtree_next(t, transform, false))
+            entity_destroy(t->pool_elem.ent);
+    else
+        entity_destroy(ent);
 }
 
 void transform_set_position(Entity ent, Vec2 pos)
@@ -280,22 +456,34 @@ Vec2 transform_get_scale(Entity ent)
     return transform->scale;
 }
 
+void transform_set_position_rotation(Entity ent, Vec2 pos, Scalar rot)
+{
+    Transform *transform = entitypool_get(pool, ent);
+    error_assert(transform);
+    transform->position = pos;
+    transform->rotation = rot;
+    _modified(transform);
+}
+
 Vec2 transform_get_world_position(Entity ent)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return mat3_get_translation(transform->worldmat_cache);
 }
 Scalar transform_get_world_rotation(Entity ent)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return mat3_get_rotation(transform->worldmat_cache);
 }
 Vec2 transform_get_world_scale(Entity ent)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return mat3_get_scale(transform->worldmat_cache);
 }
 
@@ -308,8 +496,27 @@ Mat3 transform_get_world_matrix(Entity ent)
 
     transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return transform->worldmat_cache;
 }
+Mat3 transform_elem_get_world_matrix(void *elem)
+{
+    Transform *transform = elem;
+    _update(transform);
+    return transform->worldmat_cache;
+}
+Mat3 transform_get_inverse_world_matrix(Entity ent)
+{
+    Transform *transform;
+
+    if (entity_eq(ent, entity_nil))
+        return mat3_identity();
+
+    transform = entitypool_get(pool, ent);
+    error_assert(transform);
+    _update_inverse(transform);
+    return transform->worldmat_inv_cache;
+}
 Mat3 transform_get_matrix(Entity ent)
 {
     Transform *transform;
@@ -319,21 +526,23 @@ Mat3 transform_get_matrix(Entity ent)
 
     transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return transform->mat_cache;
 }
 
-
 Vec2 transform_local_to_world(Entity ent, Vec2 v)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
+    _update(transform);
     return mat3_transform(transform->worldmat_cache, v);
 }
 Vec2 transform_world_to_local(Entity ent, Vec2 v)
 {
     Transform *transform = entitypool_get(pool, ent);
     error_assert(transform);
-    return mat3_transform(mat3_inverse(transform->worldmat_cache), v);
+    _update_inverse(transform);
+    return mat3_transform(transform->worldmat_inv_cache, v);
 }
 
 unsigned int transform_get_dirty_count(Entity ent)
@@ -342,42 +551,103 @@ unsigned int transform_get_dirty_count(Entity ent)
     error_assert(transform);
     return transform->dirty_count;
 }
+unsigned int transform_get_world_dirty_count(Entity ent)
+{
+    Transform *transform = entitypool_get(pool, ent);
+    error_assert(transform);
+    return transform->world_dirty_count;
+}
 
 void transform_set_save_filter_rec(Entity ent, bool filter)
 {
-    Transform *transform;
-    Entity *child;
-
-    entity_set_save_filter(ent, filter);
+    Transform *transform, *t;
 
     transform = entitypool_get(pool, ent);
     error_assert(transform);
-    if (transform->children)
-        array_foreach(child, transform->children)
-            transform_set_save_filter_rec(*child, filter);
+    for (t = transform; t; t = _subtree_next(t, transform, false))
+        entity_set_save_filter(t->pool_elem.ent, filter);
 }
 
 /* ------------------------------------------------------------------------- */
 
-static void _free_children_arrays()
-{
-    Transform *transform;
-
-    entitypool_foreach(transform, pool)
-        if (transform->children)
-            array_free(transform->children);
-}
-
 void transform_init()
 {
     pool = entitypool_new(Transform);
 }
 void transform_deinit()
 {
-    _free_children_arrays();
     entitypool_free(pool);
 }
 
+void transform_set_parallel(bool p)
+{
+    parallel = p;
+}
+bool transform_get_parallel()
+{
+    return parallel;
+}
+
+/* a run of the pool updated by one task */
+typedef struct UpdateRange UpdateRange;
+struct UpdateRange
+{
+    unsigned int begin, end;
+};
+
+static void _update_range(void *data, unsigned int task)
+{
+    UpdateRange *range = ((UpdateRange *) data) + task;
+    unsigned int i;
+
+    for (i = range->begin; i < range->end; ++i)
+        _update(entitypool_nth(pool, i));
+}
+
+/*
+ * split pool into ranges of about equal size and update them in parallel --
+ * in depth-first order each subtree is contiguous, so a range starting at a
+ * root or at a child of an up-to-date root never needs anything from
+ * another range
+ */
+static void _update_all_parallel()
+{
+    Transform *transform, *root = NULL;
+    UpdateRange *ranges;
+    unsigned int i, n, target, maxranges, nranges = 0, begin = 0;
+
+    n = entitypool_size(pool);
+    maxranges = worker_get_num_threads() * TASKS_PER_THREAD;
+    target = (n + maxranges - 1) / maxranges;
+    ranges = frame_alloc((n / target + 1) * sizeof(UpdateRange));
+
+    for (i = 0; i < n; ++i)
+    {
+        transform = entitypool_nth(pool, i);
+        if (entity_eq(transform->parent, entity_nil))
+        {
+            root = transform;
+            _update(root); /* so its children can start ranges */
+        }
+        else if (!entity_eq(transform->parent, root->pool_elem.ent))
+            continue;
+
+        /* root or child of root, can split here */
+        if (i - begin >= target)
+        {
+            ranges[nranges].begin = begin;
+            ranges[nranges].end = i;
+            ++nranges;
+            begin = i;
+        }
+    }
+    ranges[nranges].begin = begin;
+    ranges[nranges].end = n;
+    ++nranges;
+
+    worker_run(nranges, _update_range, ranges);
+}
+
 void transform_update_all()
 {
     Transform *transform;
@@ -385,40 +655,58 @@ void transform_update_all()
 
     entitypool_remove_destroyed(pool, transform_remove);
 
+    /*
+     * one pass to bring all matrices up to date for other systems -- in
+     * depth-first order parents are already up to date when we reach
+     * children
+     */
+    _sort();
+    if (parallel && worker_get_num_threads() > 1
+        && entitypool_size(pool) >= PARALLEL_MIN_TRANSFORMS)
+        _update_all_parallel();
+    else
+        entitypool_foreach(transform, pool)
+            _update(transform);
+
     /* update edit bbox */
     if (edit_get_enabled())
         entitypool_foreach(transform, pool)
             edit_bboxes_update(transform->pool_elem.ent, bbox);
 }
 
-/* save/load for just the children array */
-static void _children_save(Transform *t, Store *s)
+/*
+ * only parents are saved, rebuild child links of transforms from pool
+ * position first on after a load -- children end up in pool order, which
+ * is sibling order if pool was saved in depth-first order, and are
+ * appended after children their parent already had
+ */
+static void _relink_from(unsigned int first)
 {
-    Store *u;
-    Entity *child;
+    Transform *transform, *parent;
+    unsigned int i, n = entitypool_size(pool);
 
-    if (store_child_save(&u, "children", s))
-        if (t->children)
-            array_foreach(child, t->children)
-                if (entity_get_save_filter(*child))
-                    entity_save(child, NULL, u);
-}
-static void _children_load(Transform *t, Store *s)
-{
-    Store *u;
-    Entity child;
+    for (i = first; i < n; ++i)
+    {
+        transform = entitypool_nth(pool, i);
+        transform->first_child = entity_nil;
+        transform->last_child = entity_nil;
+        transform->prev_sibling = entity_nil;
+        transform->next_sibling = entity_nil;
+        transform->nchildren = 0;
+        transform->worldmat_dirty = true;
+        ++transform->world_dirty_count;
+    }
 
-    t->children = NULL;
+    for (i = first; i < n; ++i)
+    {
+        transform = entitypool_nth(pool, i);
+        if ((parent = _get(transform->parent)))
+            _attach(parent, transform);
+        else
+            transform->parent = entity_nil;
+    }
 
-    /* this is a little weird because we want NULL array when no children */
-    if (store_child_load(&u, "children", s))
-        if (entity_load(&child, NULL, entity_nil, u))
-        {
-            t->children = array_new(Entity);
-            do
-                array_add_val(Entity, t->children) = child;
-            while (entity_load(&child, NULL, entity_nil, u));
-        }
+    order_dirty = true;
 }
 
 void transform_save_all(Store *s)
@@ -426,9 +714,13 @@ void transform_save_all(Store *s)
     Store *t, *transform_s;
     Transform *transform;
 
+    _sort();
+
     if (store_child_save(&t, "transform", s))
         entitypool_save_foreach(transform, transform_s, pool, "pool", t)
         {
+            _update(transform);
+
             vec2_save(&transform->position, "position", transform_s);
             scalar_save(&transform->rotation, "rotation", transform_s);
             vec2_save(&transform->scale, "scale", transform_s);
@@ -437,7 +729,6 @@ void transform_save_all(Store *s)
                 entity_save(&transform->parent, "parent", transform_s);
             else
                 entity_save(&entity_nil, "parent", transform_s);
-            _children_save(transform, transform_s);
 
             mat3_save(&transform->mat_cache, "mat_cache", transform_s);
             mat3_save(&transform->worldmat_cache, "worldmat_cache",
@@ -450,22 +741,42 @@ void transform_load_all(Store *s)
 {
     Store *t, *transform_s;
     Transform *transform;
+    unsigned int first, nloaded = 0;
 
     if (store_child_load(&t, "transform", s))
+    {
+        /* new transforms are added at the end of the pool */
+        first = entitypool_size(pool);
+
         entitypool_load_foreach(transform, transform_s, pool, "pool", t)
         {
+            ++nloaded;
+
             vec2_load(&transform->position, "position", vec2_zero, transform_s);
             scalar_load(&transform->rotation, "rotation", 0, transform_s);
             vec2_load(&transform->scale, "scale", vec2(1, 1), transform_s);
 
             entity_load(&transform->parent, "parent", entity_nil, transform_s);
-            _children_load(transform, transform_s);
 
             mat3_load(&transform->mat_cache, "mat_cache", mat3_identity(),
                       transform_s);
             mat3_load(&transform->worldmat_cache, "worldmat_cache",
                       mat3_identity(), transform_s);
+            transform->mat_dirty = true;
+            transform->worldmat_dirty = true;
+            transform->worldmat_inv_dirty = true;
 
             uint_load(&transform->dirty_count, "dirty_count", 0, transform_s);
         }
+
+        /*
+         * a merge (prefab, clipboard) only adds transforms, so existing
+         * links are left alone -- if some existing ones were overwritten
+         * their old links are stale, so relink everything
+         */
+        if (entitypool_size(pool) - first == nloaded)
+            _relink_from(first);
+        else
+            _relink_from(0);
+    }
 }
@@ -5,6 +5,7 @@
 #include "vec2.h"
 #include "mat3.h"
 #include "entity.h"
+#include "entitypool.h"
 #include "script_export.h"
 #include "saveload.h"
 
@@ -17,11 +18,22 @@ SCRIPT(transform,
        EXPORT void transform_add(Entity ent);
        EXPORT void transform_remove(Entity ent);
        EXPORT bool transform_has(Entity ent);
+       EXPORT EntityPool *transform_get_pool(); /* for entitypool_join_*() */
+
+       /*
+        * add to n entities at once -- positions, rotations, scales are
+        * arrays of n initial values, or NULL to use the defaults
+        */
+       EXPORT void transform_add_n(unsigned int n, const Entity *ents,
+                                   const Vec2 *positions,
+                                   const Scalar *rotations,
+                                   const Vec2 *scales);
 
        /* root transforms have parent = entity_nil */
        EXPORT void transform_set_parent(Entity ent, Entity parent);
        EXPORT Entity transform_get_parent(Entity ent);
        EXPORT unsigned int transform_get_num_children(Entity ent);
+       /* array in frame memory (see frame.h), NULL if no children */
        EXPORT Entity *transform_get_children(Entity ent);
        /* detach from parent and all children */
        EXPORT void transform_detach_all(Entity ent);
@@ -39,6 +51,10 @@ SCRIPT(transform,
        EXPORT void transform_set_scale(Entity ent, Vec2 scale);
        EXPORT Vec2 transform_get_scale(Entity ent);
 
+       /* both at once, counts as one modification */
+       EXPORT void transform_set_position_rotation(Entity ent, Vec2 pos,
+                                                   Scalar rot);
+
        EXPORT Vec2 transform_get_world_position(Entity ent);
        EXPORT Scalar transform_get_world_rotation(Entity ent);
        EXPORT Vec2 transform_get_world_scale(Entity ent);
@@ -48,6 +64,7 @@ SCRIPT(transform,
         * parent-space is identity
         */
        EXPORT Mat3 transform_get_world_matrix(Entity ent); /* world-space */
+       EXPORT Mat3 transform_get_inverse_world_matrix(Entity ent); /* cached */
        EXPORT Mat3 transform_get_matrix(Entity ent); /* parent-space */
 
        EXPORT Vec2 transform_local_to_world(Entity ent, Vec2 v);
@@ -55,11 +72,32 @@ SCRIPT(transform,
 
        EXPORT unsigned int transform_get_dirty_count(Entity ent);
 
+       /*
+        * like transform_get_dirty_count(...) but also changes when an
+        * ancestor is modified or the parent is changed, so whenever the
+        * world matrix may have
+        */
+       EXPORT unsigned int transform_get_world_dirty_count(Entity ent);
+
+       /*
+        * update world matrices of separate subtrees on worker threads
+        * (see worker.h) when there are many transforms, on by default
+        */
+       EXPORT void transform_set_parallel(bool parallel);
+       EXPORT bool transform_get_parallel();
+
        /* set save filter for ent and all its descendants */
        EXPORT void transform_set_save_filter_rec(Entity ent, bool filter);
 
     )
 
+/*
+ * same as transform_get_world_matrix(...) but takes an element of
+ * transform_get_pool(), eg. from entitypool_join_next(...), saving the
+ * lookup
+ */
+Mat3 transform_elem_get_world_matrix(void *elem);
+
 void transform_init();
 void transform_deinit();
 void transform_update_all();
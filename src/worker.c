@@ -0,0 +1,228 @@
+#ifndef CGAME_WINDOWS
+#define _POSIX_C_SOURCE 200112L /* for sysconf(...) */
+#endif
+
+#include "worker.h"
+
+#include <stdbool.h>
+
+#include "error.h"
+
+#ifdef CGAME_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 8 /* including caller */
+
+/* platform bits */
+
+#ifdef CGAME_WINDOWS
+
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Cond;
+
+#define mutex_init(m) InitializeCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+#define mutex_lock(m) EnterCriticalSection(m)
+#define mutex_unlock(m) LeaveCriticalSection(m)
+#define cond_init(c) InitializeConditionVariable(c)
+#define cond_destroy(c) ((void) 0)
+#define cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+
+static DWORD WINAPI _thread_main(LPVOID p);
+
+static bool _thread_start(Thread *thread)
+{
+    *thread = CreateThread(NULL, 0, _thread_main, NULL, 0, NULL);
+    return *thread != NULL;
+}
+static void _thread_join(Thread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+static unsigned int _num_cpus()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+
+#define mutex_init(m) pthread_mutex_init(m, NULL)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m) pthread_mutex_lock(m)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+#define cond_init(c) pthread_cond_init(c, NULL)
+#define cond_destroy(c) pthread_cond_destroy(c)
+#define cond_wait(c, m) pthread_cond_wait(c, m)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+
+static void *_thread_main(void *p);
+
+static bool _thread_start(Thread *thread)
+{
+    return pthread_create(thread, NULL, _thread_main, NULL) == 0;
+}
+static void _thread_join(Thread thread)
+{
+    pthread_join(thread, NULL);
+}
+static unsigned int _num_cpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static Thread threads[MAX_THREADS];
+static unsigned int nthreads = 0; /* not including caller */
+
+/* all below protected by mutex */
+static Mutex mutex;
+static Cond work_cond; /* signalled when new work or quit */
+static Cond done_cond; /* signalled when all tasks done */
+
+static WorkerFunc func;
+static void *data;
+static unsigned int ntasks;
+static unsigned int next_task; /* next task to hand out */
+static unsigned int ndone; /* tasks finished */
+static unsigned int run_count = 0; /* incremented per worker_run(...) */
+static bool quit = false;
+
+/* run tasks till none left, called and returns with mutex locked */
+static void _run_tasks()
+{
+    unsigned int task;
+
+    while (next_task < ntasks)
+    {
+        task = next_task++;
+        mutex_unlock(&mutex);
+        func(data, task);
+        mutex_lock(&mutex);
+
+        if (++ndone == ntasks)
+            cond_broadcast(&done_cond);
+    }
+}
+
+static void _worker_main()
+{
+    unsigned int seen = 0;
+
+    mutex_lock(&mutex);
+    for (;;)
+    {
+        while (!quit && seen == run_count)
+            cond_wait(&work_cond, &mutex);
+        if (quit)
+            break;
+        seen = run_count;
+
+        _run_tasks();
+    }
+    mutex_unlock(&mutex);
+}
+
+#ifdef CGAME_WINDOWS
+static DWORD WINAPI _thread_main(LPVOID p)
+{
+    _worker_main();
+    return 0;
+}
+#else
+static void *_thread_main(void *p)
+{
+    _worker_main();
+    return NULL;
+}
+#endif
+
+void worker_run(unsigned int n, WorkerFunc f, void *d)
+{
+    unsigned int i;
+
+    /* no point waking anyone for one task */
+    if (nthreads == 0 || n <= 1)
+    {
+        for (i = 0; i < n; ++i)
+            f(d, i);
+        return;
+    }
+
+    mutex_lock(&mutex);
+    error_assert(ndone == ntasks, "worker_run(...) isn't reentrant");
+
+    func = f;
+    data = d;
+    ntasks = n;
+    next_task = 0;
+    ndone = 0;
+    ++run_count;
+    cond_broadcast(&work_cond);
+
+    /* pitch in, then wait for stragglers */
+    _run_tasks();
+    while (ndone < ntasks)
+        cond_wait(&done_cond, &mutex);
+
+    mutex_unlock(&mutex);
+}
+
+unsigned int worker_get_num_threads()
+{
+    return nthreads + 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void worker_init()
+{
+    unsigned int n;
+
+    mutex_init(&mutex);
+    cond_init(&work_cond);
+    cond_init(&done_cond);
+    ntasks = ndone = next_task = 0;
+    quit = false;
+
+    /* one per cpu, caller counts as one */
+    n = _num_cpus();
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    for (nthreads = 0; nthreads + 1 < n; ++nthreads)
+        if (!_thread_start(&threads[nthreads]))
+            break; /* make do with what we have */
+}
+void worker_deinit()
+{
+    unsigned int i;
+
+    mutex_lock(&mutex);
+    quit = true;
+    cond_broadcast(&work_cond);
+    mutex_unlock(&mutex);
+
+    for (i = 0; i < nthreads; ++i)
+        _thread_join(threads[i]);
+    nthreads = 0;
+
+    cond_destroy(&done_cond);
+    cond_destroy(&work_cond);
+    mutex_destroy(&mutex);
+}
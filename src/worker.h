@@ -0,0 +1,25 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+/*
+ * small pool of worker threads for splitting up work within a frame --
+ * worker_run(...) calls func(data, task) for each task in [0, ntasks) on
+ * the workers and the calling thread, and returns when all are done
+ *
+ * tasks run concurrently so func must only touch data owned by its task,
+ * and must not call back into systems that aren't thread-safe (almost all
+ * of them)
+ */
+
+typedef void (*WorkerFunc)(void *data, unsigned int task);
+
+void worker_run(unsigned int ntasks, WorkerFunc func, void *data);
+
+/* number of threads worker_run(...) spreads work over, including caller */
+unsigned int worker_get_num_threads();
+
+void worker_init();
+void worker_deinit();
+
+#endif
+
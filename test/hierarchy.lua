@@ -0,0 +1,88 @@
+--
+-- transform hierarchy benchmark, run as
+--
+--     cgame test/hierarchy.lua [wide|deep] [n_transforms]
+--
+-- 'wide' makes many small trees, 'deep' makes a few tall ones -- all roots
+-- spin so every world matrix is recomputed each frame, and average frame
+-- time is printed with parallel transform update off and on in turn --
+-- with '--headless' it quits after a few rounds
+--
+
+local ffi = require 'ffi'
+
+cs.sprite.set_atlas('./test/atlas.png')
+
+camera = cs.entity.create()
+cs.transform.add(camera)
+cs.camera.add(camera)
+cs.camera.set_viewport_height(camera, 18)
+
+math.randomseed(os.time())
+
+local shape = cg.args[2] or 'wide'
+local n = tonumber(cg.args[3]) or 100000
+print('creating ' .. n .. ' transforms, ' .. shape)
+
+local ents = cs.entity.create_n(n)
+local poss = ffi.new('Vec2[?]', n)
+for i = 0, n - 1 do
+    poss[i] = cg.vec2(math.random() - 0.5, math.random() - 0.5)
+end
+cs.transform.add_n(n, ents, poss, nil, nil)
+
+-- 'wide': trees of 16, each node under a random earlier one in its tree
+-- 'deep': 64 trees, chains of 32 hanging off random earlier nodes
+local roots = {}
+for i = 0, n - 1 do
+    if shape == 'deep' then
+        if i < 64 then
+            table.insert(roots, ents[i])
+        elseif i % 32 == 0 then
+            cs.transform.set_parent(ents[i], ents[math.random(0, i - 1)])
+        else
+            cs.transform.set_parent(ents[i], ents[i - 1])
+        end
+    else
+        if i % 16 == 0 then
+            table.insert(roots, ents[i])
+        else
+            cs.transform.set_parent(ents[i], ents[i - math.random(1, i % 16)])
+        end
+    end
+end
+
+-- a few sprites so there's something to look at
+for i = 0, n - 1, math.max(1, math.floor(n / 1000)) do
+    cs.sprite.add(ents[i])
+    cs.sprite.set_texcell(ents[i], cg.vec2(32.0, 32.0))
+    cs.sprite.set_texsize(ents[i], cg.vec2(32.0, 32.0))
+end
+
+-- spin roots, time rounds of frames alternating parallel off and on
+
+cs.hierarchy_bench = {}
+
+local round_frames = 300
+local nframes, timer, nrounds = 0, 0, 0
+
+function cs.hierarchy_bench.update_all()
+    for _, root in ipairs(roots) do
+        cs.transform.rotate(root, cs.timing.dt)
+    end
+
+    nframes = nframes + 1
+    timer = timer + cs.timing.true_dt
+    if nframes == round_frames then
+        print(string.format('parallel %-5s %.3f ms/frame',
+                            tostring(cs.transform.get_parallel()),
+                            1000 * timer / nframes))
+        cs.transform.set_parallel(not cs.transform.get_parallel())
+        nframes, timer = 0, 0
+
+        nrounds = nrounds + 1
+        if cs.headless.get_enabled() and nrounds == 4 then
+            cs.game.quit()
+        end
+    end
+end
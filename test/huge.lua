@@ -1,3 +1,5 @@
+local ffi = require 'ffi'
+
 require 'test.oscillator'
 require 'test.rotator'
 
@@ -20,29 +22,35 @@ end
 
 local n_blocks = cg.args[2] or 30000
 print('creating ' .. n_blocks .. ' blocks')
-for i = 0, n_blocks do
-    local block = cs.entity.create()
 
+-- create in bulk, a few calls instead of several per block -- blocks 0 to
+-- n_blocks inclusive, so the workload is what it always was
+local n = n_blocks + 1
+local blocks = cs.entity.create_n(n)
+local poss = ffi.new('Vec2[?]', n)
+local texcells = ffi.new('Vec2[?]', n)
+local texsizes = ffi.new('Vec2[?]', n)
+for i = 0, n - 1 do
     local y = 8 * symrand()
     while math.abs(y) < 1.5 do
         y = 8 * symrand()
     end
-    local pos = cg.vec2(8 * symrand(), y)
-
-    cs.transform.add(block)
-    cs.transform.set_position(block, pos)
+    poss[i] = cg.vec2(8 * symrand(), y)
 
-    cs.sprite.add(block)
     if symrand() < 0 then
-        cs.sprite.set_texcell(block, cg.vec2( 0.0, 32.0))
-        cs.edit.select[block] = true
+        texcells[i] = cg.vec2( 0.0, 32.0)
+        cs.edit.select[blocks[i]] = true
     else
-        cs.sprite.set_texcell(block, cg.vec2(32.0, 32.0))
+        texcells[i] = cg.vec2(32.0, 32.0)
     end
-    cs.sprite.set_texsize(block, cg.vec2(32.0, 32.0))
+    texsizes[i] = cg.vec2(32.0, 32.0)
+end
+cs.transform.add_n(n, blocks, poss, nil, nil)
+cs.sprite.add_n(n, blocks, nil, texcells, texsizes, nil)
 
-    cs.oscillator.add(block, { amp = 3 * math.random(), freq = math.random() })
-    cs.rotator.add(block, math.random() * math.pi)
+for i = 0, n - 1 do
+    cs.oscillator.add(blocks[i], { amp = 3 * math.random(), freq = math.random() })
+    cs.rotator.add(blocks[i], math.random() * math.pi)
 end
 
 -- add player